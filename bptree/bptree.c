@@ -496,6 +496,89 @@ extern int bp_range(struct bp* bp, ukey_t k, unsigned int len, uval_t* v_arr) {
     return cnt;
 }
 
+extern void bp_cursor_open(struct bp* bp, struct bp_cursor* cur, ukey_t k) {
+    struct list_head *list;
+    struct page* page;
+    int i;
+
+    cur->bp = bp;
+    cur->page = NULL;
+    cur->idx = 0;
+
+    read_lock(&bp->list_lock);
+
+    list = &bp->leaf_list;
+    list_for_each_entry(page, list, list) {
+        read_lock(&page->lock);
+        if (page->length && k_cmp(page->kv[page->length - 1].k, k) >= 0) {
+            for (i = 0; k_cmp(page->kv[i].k, k) < 0; i++);
+            cur->page = page;
+            cur->idx = i;
+            return;
+        }
+        read_unlock(&page->lock);
+    }
+}
+
+/* return the entry under the cursor and move forward, NULL at the end */
+static bp_kv_t* cursor_step(struct bp_cursor* cur) {
+    struct page* page = cur->page;
+
+    while(page && cur->idx == page->length) {
+        /* leaves can't be split or merged while we hold list_lock */
+        read_unlock(&page->lock);
+        if (page->list.next == &cur->bp->leaf_list) {
+            page = NULL;
+        } else {
+            page = list_next_entry(page, list);
+            read_lock(&page->lock);
+        }
+        cur->idx = 0;
+    }
+    cur->page = page;
+
+    return page ? &page->kv[cur->idx++] : NULL;
+}
+
+/* copy at most len entries under the cursor and move forward, 0 at the end */
+extern int bp_cursor_next(struct bp_cursor* cur, entry_t* e_arr, unsigned int len) {
+    bp_kv_t* kv;
+    unsigned int cnt = 0;
+
+    while(cnt < len && (kv = cursor_step(cur))) {
+        e_arr[cnt++] = *kv;
+    }
+
+    return cnt;
+}
+
+extern void bp_cursor_close(struct bp_cursor* cur) {
+    if (cur->page) {
+        read_unlock(&cur->page->lock);
+    }
+    read_unlock(&cur->bp->list_lock);
+}
+
+/* call fun on every entry >= k in place until it returns non-zero */
+extern int bp_scan(struct bp* bp, ukey_t k, scan_fun_t fun, void* arg) {
+    struct bp_cursor cur;
+    bp_kv_t* kv;
+    int cnt = 0;
+
+    bp_cursor_open(bp, &cur, k);
+
+    while((kv = cursor_step(&cur))) {
+        cnt++;
+        if (fun(kv->k, kv->v, arg)) {
+            break;
+        }
+    }
+
+    bp_cursor_close(&cur);
+
+    return cnt;
+}
+
 static void print_page(char* prefix, int p_len, ukey_t anchor, struct page* page, int is_first) {
     int i;
     char *__prefix = NULL;
@@ -17,10 +17,22 @@ typedef entry_t bp_kv_t;
 #define BP_INTER    0x200
 #define BP_LEAF     0x201
 
+/*
+ * -D BP_OLC builds bptree_olc.c: optimistic lock coupling. readers check
+ * page versions instead of taking locks, writers lock the leaf, plus the
+ * parent when a page splits. pages are never merged nor freed before
+ * bp_destroy(), a delete may leave an empty leaf behind.
+ */
+
 struct page {
     int type;
     int length;
+#ifdef BP_OLC
+    /* odd while a writer holds the page */
+    unsigned long version;
+#else
     rwlock_t lock;
+#endif
 
     /* leaf use only*/
     struct list_head list;
@@ -30,18 +42,44 @@ struct page {
 
 struct bp {
     int degree;
+#ifndef BP_OLC
     rwlock_t root_lock;
+#endif
     struct page* root;
 
+#ifndef BP_OLC
     rwlock_t list_lock;
+#endif
     struct list_head leaf_list;
 };
 
+#ifdef BP_OLC
+/* a cursor holds no lock, it remembers the last key and finds its place again */
+struct bp_cursor {
+    struct bp* bp;
+    struct page* page;
+    ukey_t k;
+    /* set once k was returned, the next entry is then above it */
+    int idx;
+};
+#else
+/* a cursor holds the leaf list and its current leaf read-locked until it is closed */
+struct bp_cursor {
+    struct bp* bp;
+    struct page* page;
+    int idx;
+};
+#endif
+
 extern struct bp* bp_create(unsigned int degree);
 extern void bp_destroy(struct bp* bp);
 extern int bp_insert(struct bp* bp, ukey_t k, uval_t v);
 extern int bp_lookup(struct bp* bp, ukey_t k, uval_t* v);
 extern int bp_remove(struct bp* bp, ukey_t k);
 extern int bp_range(struct bp* bp, ukey_t k, unsigned int len, uval_t* v_arr);
+extern void bp_cursor_open(struct bp* bp, struct bp_cursor* cur, ukey_t k);
+extern int bp_cursor_next(struct bp_cursor* cur, entry_t* e_arr, unsigned int len);
+extern void bp_cursor_close(struct bp_cursor* cur);
+extern int bp_scan(struct bp* bp, ukey_t k, scan_fun_t fun, void* arg);
 extern void bp_print(struct bp* bp);
 #endif
\ No newline at end of file
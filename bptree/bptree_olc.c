@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <sched.h>
+
+#include "list.h"
+#include "atomic.h"
+#include "bptree.h"
+
+/* inter node */
+/* <MIN_KEY, p0>, <k1, p1>, <k2, p2> ... <kn+1, pn+1>*/
+/* max_key(p[i - 1]) < k[i] */
+
+/* leaf node */
+/* <k0, v0>, <k1, v1>, <k2, v2> ... <kn, vn>*/
+
+/*
+ * a reader takes a page's version, reads what it needs and checks that
+ * the version did not move meanwhile. whatever it read before that may
+ * be torn, so it must not be trusted until then: a child pointer is only
+ * followed once its parent is checked. pages are never freed, a stale
+ * pointer still points to a page.
+ */
+
+/* pause loops before a reader gives its core away to the writer */
+#define OLC_YIELD_LOOPS     1024
+
+#define BP_SCAN_BATCH       64
+
+static unsigned long olc_read(struct page* page) {
+    unsigned long version;
+    unsigned int spins = 0;
+
+    while((version = ACCESS_ONCE(page->version)) & 1) {
+        cpu_relax();
+        if (++spins == OLC_YIELD_LOOPS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+    barrier();
+
+    return version;
+}
+
+static int olc_check(struct page* page, unsigned long version) {
+    barrier();
+    return ACCESS_ONCE(page->version) == version;
+}
+
+/* lock the page if nobody wrote it since version was read */
+static int olc_upgrade(struct page* page, unsigned long version) {
+    return cmpxchg2(&page->version, version, version + 1);
+}
+
+static void olc_unlock(struct page* page) {
+    barrier();
+    ACCESS_ONCE(page->version) = page->version + 1;
+}
+
+static struct page* alloc_page(struct bp* bp, int type) {
+    int is_inter = (type == BP_INTER) ? 1 : 0;
+    int size = sizeof(struct page) + (bp->degree + is_inter)* sizeof(bp_kv_t);
+    struct page* page = (struct page*) malloc(size);
+
+    page->type = type;
+    page->length = 0;
+    page->kv[0].k = 0;
+    page->version = 0;
+
+    return page;
+}
+
+extern struct bp* bp_create(unsigned int degree) {
+    struct bp* bp = (struct bp*) malloc(sizeof(struct bp));
+
+    bp->degree = degree;
+    bp->root = alloc_page(bp, BP_LEAF);
+    INIT_LIST_HEAD(&bp->leaf_list);
+    list_add(&bp->root->list, &bp->leaf_list);
+
+    return bp;
+}
+
+static void free_page(struct page* page) {
+    free(page);
+}
+
+static void free_all_pages(struct page* page) {
+    int i;
+
+    if (page->type == BP_INTER) {
+        for (i = 0; i < page->length; i++) {
+            free_all_pages((struct page*) (page->kv[i].v));
+        }
+    }
+    free_page(page);
+}
+
+extern void bp_destroy(struct bp* bp) {
+    free_all_pages(bp->root);
+    free(bp);
+}
+
+/* return the last index that k[idx] <= k, -1 if none */
+static int binary_search_in_page(struct page* page, ukey_t k, int length) {
+    int l = 0, r = length;
+    int mid;
+
+    while(l < r) {
+        mid = (l + r) >> 1;
+        if (k_cmp(page->kv[mid].k, k) <= 0) {
+            l = mid + 1;
+        } else {
+            r = mid;
+        }
+    }
+
+    return l - 1;
+}
+
+/* length is read once, a torn value still keeps the search inside the page */
+static int page_length(struct bp* bp, struct page* page) {
+    int length = ACCESS_ONCE(page->length);
+    int max = bp->degree + (page->type == BP_INTER ? 1 : 0);
+
+    return length < 0 ? 0 : (length > max ? max : length);
+}
+
+static int is_full(struct bp* bp, struct page* page) {
+    return page_length(bp, page) == bp->degree + (page->type == BP_INTER ? 1 : 0);
+}
+
+/* the leaf that may hold k, with the version it was read at */
+static struct page* find_leaf(struct bp* bp, ukey_t k, unsigned long* version) {
+    struct page *page, *child;
+    unsigned long v, cv;
+    int idx;
+
+restart:
+    page = ACCESS_ONCE(bp->root);
+    v = olc_read(page);
+    /* a root split locks the old root first, then replaces it */
+    if (page != ACCESS_ONCE(bp->root)) {
+        goto restart;
+    }
+
+    while(page->type == BP_INTER) {
+        idx = binary_search_in_page(page, k, page_length(bp, page));
+        child = (struct page*) page->kv[idx < 0 ? 0 : idx].v;
+        if (!olc_check(page, v)) {
+            goto restart;
+        }
+        cv = olc_read(child);
+        /* the child may have moved to a new sibling before cv was taken */
+        if (!olc_check(page, v)) {
+            goto restart;
+        }
+        page = child;
+        v = cv;
+    }
+
+    *version = v;
+    return page;
+}
+
+/* called with fa_page locked and not full */
+static void page_insert(struct page* fa_page, ukey_t k, struct page* new_page) {
+    int idx, i;
+
+    idx = binary_search_in_page(fa_page, k, fa_page->length);
+    assert(idx >= 0 && k_cmp(fa_page->kv[idx].k, k) < 0);
+
+    for (i = fa_page->length - 1; i > idx; i--) {
+        memcpy(&fa_page->kv[i + 1], &fa_page->kv[i], sizeof(bp_kv_t));
+    }
+
+    fa_page->kv[idx + 1].k = k;
+    fa_page->kv[idx + 1].v = (uval_t) new_page;
+    fa_page->length++;
+}
+
+/*
+ * called with page locked, move its upper half to a new right sibling
+ * and return it with the first key it covers in *k. an inter page moves
+ * whole <k, p> pairs, the first one turns into the MIN_KEY slot.
+ */
+static struct page* split(struct bp* bp, struct page* page, ukey_t* k) {
+    struct page* new_page = alloc_page(bp, page->type);
+    int length = page->length / 2;
+    int st = page->length - length;
+
+    memcpy(&new_page->kv[0], &page->kv[st], length * sizeof(bp_kv_t));
+    new_page->length = length;
+    *k = new_page->kv[0].k;
+    if (page->type == BP_INTER) {
+        new_page->kv[0].k = 0;
+    } else {
+        /* readers get to the new leaf through page, which is locked */
+        list_add(&new_page->list, &page->list);
+    }
+
+    page->length = st;
+
+    return new_page;
+}
+
+/*
+ * split a full page on the way down, so the parent it goes into always
+ * has room and no more than these two pages are ever locked. the caller
+ * restarts from the root afterwards.
+ */
+static void split_on_the_way(struct bp* bp, struct page* fa_page, unsigned long fv, struct page* page, unsigned long v) {
+    struct page *new_page, *root;
+    ukey_t k;
+
+    if (fa_page && !olc_upgrade(fa_page, fv)) {
+        return;
+    }
+    if (!olc_upgrade(page, v)) {
+        if (fa_page) {
+            olc_unlock(fa_page);
+        }
+        return;
+    }
+
+    new_page = split(bp, page, &k);
+    if (fa_page) {
+        page_insert(fa_page, k, new_page);
+        olc_unlock(fa_page);
+    } else {
+        /* page was the root when v was read, v still holds, so it still is */
+        root = alloc_page(bp, BP_INTER);
+        root->kv[0].v = (uval_t) page;
+        root->kv[1].k = k;
+        root->kv[1].v = (uval_t) new_page;
+        root->length = 2;
+        barrier();
+        ACCESS_ONCE(bp->root) = root;
+    }
+    olc_unlock(page);
+}
+
+extern int bp_insert(struct bp* bp, ukey_t k, uval_t v) {
+    struct page *page, *fa_page, *child;
+    unsigned long pv, fv, cv;
+    int idx, i;
+
+restart:
+    fa_page = NULL;
+    fv = 0;
+    page = ACCESS_ONCE(bp->root);
+    pv = olc_read(page);
+    if (page != ACCESS_ONCE(bp->root)) {
+        goto restart;
+    }
+
+    while(1) {
+        if (is_full(bp, page)) {
+            split_on_the_way(bp, fa_page, fv, page, pv);
+            goto restart;
+        }
+        if (page->type == BP_LEAF) {
+            break;
+        }
+
+        idx = binary_search_in_page(page, k, page_length(bp, page));
+        child = (struct page*) page->kv[idx < 0 ? 0 : idx].v;
+        if (!olc_check(page, pv)) {
+            goto restart;
+        }
+        cv = olc_read(child);
+        if (!olc_check(page, pv)) {
+            goto restart;
+        }
+        fa_page = page;
+        fv = pv;
+        page = child;
+        pv = cv;
+    }
+
+    /* only the leaf is locked */
+    if (!olc_upgrade(page, pv)) {
+        goto restart;
+    }
+
+    idx = binary_search_in_page(page, k, page->length);
+    if (idx >= 0 && k_cmp(page->kv[idx].k, k) == 0) {
+        olc_unlock(page);
+        return -EEXIST;
+    }
+
+    for (i = page->length - 1; i > idx; i--) {
+        memcpy(&page->kv[i + 1], &page->kv[i], sizeof(bp_kv_t));
+    }
+
+    page->kv[idx + 1].k = k;
+    page->kv[idx + 1].v = v;
+    page->length++;
+
+    olc_unlock(page);
+
+    return 0;
+}
+
+extern int bp_lookup(struct bp* bp, ukey_t k, uval_t* v) {
+    struct page* leaf;
+    unsigned long version;
+    uval_t __v;
+    int idx, found;
+
+    do {
+        leaf = find_leaf(bp, k, &version);
+        idx = binary_search_in_page(leaf, k, page_length(bp, leaf));
+        found = idx >= 0 && k_cmp(leaf->kv[idx].k, k) == 0;
+        __v = found ? leaf->kv[idx].v : 0;
+    } while(!olc_check(leaf, version));
+
+    if (found) {
+        *v = __v;
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+/* no merge, the leaf stays where it is even if it runs empty */
+extern int bp_remove(struct bp* bp, ukey_t k) {
+    struct page* leaf;
+    unsigned long version;
+    int idx, i;
+
+    do {
+        leaf = find_leaf(bp, k, &version);
+    } while(!olc_upgrade(leaf, version));
+
+    idx = binary_search_in_page(leaf, k, leaf->length);
+    if (idx < 0 || k_cmp(leaf->kv[idx].k, k) != 0) {
+        olc_unlock(leaf);
+        return -ENOENT;
+    }
+
+    for (i = idx + 1; i < leaf->length; i++) {
+        memcpy(&leaf->kv[i - 1], &leaf->kv[i], sizeof(bp_kv_t));
+    }
+    leaf->length--;
+
+    olc_unlock(leaf);
+
+    return 0;
+}
+
+extern void bp_cursor_open(struct bp* bp, struct bp_cursor* cur, ukey_t k) {
+    unsigned long version;
+
+    cur->bp = bp;
+    /* later splits only move keys right, the leaf list still leads to them */
+    cur->page = find_leaf(bp, k, &version);
+    cur->k = k;
+    cur->idx = 0;
+}
+
+extern int bp_cursor_next(struct bp_cursor* cur, entry_t* e_arr, unsigned int len) {
+    struct page *page, *next;
+    unsigned long version;
+    unsigned int cnt;
+    int length, i;
+
+    while((page = cur->page)) {
+        version = olc_read(page);
+        length = page_length(cur->bp, page);
+
+        i = binary_search_in_page(page, cur->k, length);
+        /* i is the last key <= cur->k, step past it unless it is still wanted */
+        if (i < 0 || cur->idx || k_cmp(page->kv[i].k, cur->k) != 0) {
+            i++;
+        }
+        for (cnt = 0; i < length && cnt < len; i++) {
+            e_arr[cnt++] = page->kv[i];
+        }
+        next = (i < length) ? page :
+            (page->list.next == &cur->bp->leaf_list ? NULL : list_next_entry(page, list));
+
+        if (!olc_check(page, version)) {
+            continue;
+        }
+
+        cur->page = next;
+        if (cnt) {
+            cur->k = e_arr[cnt - 1].k;
+            cur->idx = 1;
+            return cnt;
+        }
+    }
+
+    return 0;
+}
+
+extern void bp_cursor_close(struct bp_cursor* cur) {
+    cur->page = NULL;
+}
+
+extern int bp_range(struct bp* bp, ukey_t k, unsigned int len, uval_t* v_arr) {
+    struct bp_cursor cur;
+    entry_t batch[BP_SCAN_BATCH];
+    unsigned int cnt = 0;
+    int ret, i;
+
+    bp_cursor_open(bp, &cur, k);
+
+    while(cnt < len && (ret = bp_cursor_next(&cur, batch, len - cnt < BP_SCAN_BATCH ? len - cnt : BP_SCAN_BATCH))) {
+        for (i = 0; i < ret; i++) {
+            v_arr[cnt++] = batch[i].v;
+        }
+    }
+
+    bp_cursor_close(&cur);
+
+    return cnt;
+}
+
+/* call fun on every entry >= k until it returns non-zero, on copies taken a batch at a time */
+extern int bp_scan(struct bp* bp, ukey_t k, scan_fun_t fun, void* arg) {
+    struct bp_cursor cur;
+    entry_t batch[BP_SCAN_BATCH];
+    int cnt = 0, ret, i;
+
+    bp_cursor_open(bp, &cur, k);
+
+    while((ret = bp_cursor_next(&cur, batch, BP_SCAN_BATCH))) {
+        for (i = 0; i < ret; i++) {
+            cnt++;
+            if (fun(batch[i].k, batch[i].v, arg)) {
+                goto out;
+            }
+        }
+    }
+
+out:
+    bp_cursor_close(&cur);
+
+    return cnt;
+}
+
+static void print_page(char* prefix, int p_len, ukey_t anchor, struct page* page, int is_first) {
+    int i;
+    char *__prefix = NULL;
+    struct page* child_page;
+
+    printf("%s", prefix);
+    printf(is_first ? "├──" : "└──");
+    printf("%lu\n", anchor);
+
+    if (!page) {
+        return;
+    }
+    if (page->type == BP_INTER) {
+        for (i = 0; i < page->length; i++) {
+            __prefix = malloc(p_len  + 10);
+            strcpy(__prefix, prefix);
+            strcat(__prefix, is_first ? "│   " : "    ");
+            child_page = (struct page*) page->kv[i].v;
+            print_page(__prefix, p_len  + 10, page->kv[i].k, child_page, i == 0);
+        }
+    } else if (page->type == BP_LEAF) {
+        for (i = 0; i < page->length; i++) {
+            __prefix = malloc(p_len  + 10);
+            strcpy(__prefix, prefix);
+            strcat(__prefix, is_first ? "│   " : "    ");
+            print_page(__prefix, p_len  + 10, page->kv[i].k, NULL, i == 0);
+        }
+    }
+
+    if (__prefix) free(__prefix);
+}
+
+extern void bp_print(struct bp* bp) {
+    print_page("", 1, 0, bp->root, 1);
+}
@@ -16,6 +16,7 @@
 
 #define N           10000000
 #define NUM_THREAD  8
+#define SCAN_BATCH  64
 
 #define RAND
 // #define DETAIL
@@ -147,6 +148,42 @@ static void do_range(long id) {
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
 }
 
+/* stop the visitor halfway */
+static int count_fun(ukey_t k, uval_t v, void* arg) {
+    long* cnt = (long*) arg;
+
+    return ++(*cnt) == N / 2;
+}
+
+static void do_scan(long id) {
+    struct bp_cursor cur;
+    entry_t batch[SCAN_BATCH];
+    ukey_t last = 0;
+    long cnt = 0;
+    int i, ret;
+    double interval;
+
+    start_measure();
+
+    bp_cursor_open(bp, &cur, 0);
+    while((ret = bp_cursor_next(&cur, batch, SCAN_BATCH)) > 0) {
+        for (i = 0; i < ret; i++) {
+            test_assert(k_cmp(batch[i].k, last) > 0);
+            last = batch[i].k;
+        }
+        cnt += ret;
+    }
+    bp_cursor_close(&cur);
+    test_assert(cnt == N);
+
+    cnt = 0;
+    ret = bp_scan(bp, 0, count_fun, &cnt);
+    test_assert(ret == N / 2 && cnt == N / 2);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
 static void do_barrier(long id, const char* arg) {
     pthread_barrier_wait(&barrier);
     if (id == 0) {
@@ -169,6 +206,10 @@ void* test(void* arg) {
 
     do_barrier(id, "RANGE");
 
+    do_scan(id);
+
+    do_barrier(id, "SCAN");
+
     do_remove(id, 0);
 
     do_barrier(id, "REMOVE");
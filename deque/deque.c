@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "deque.h"
+
+static struct d_array* alloc_array(long size) {
+    struct d_array* a = (struct d_array*) malloc(sizeof(struct d_array) + size * sizeof(uval_t));
+
+    a->mask = size - 1;
+
+    return a;
+}
+
+static void free_array(struct d_array* a) {
+    free(a);
+}
+
+/* size is rounded up to a power of two */
+struct deque* d_create(int size) {
+    struct deque* dq = (struct deque*) aligned_alloc(CACHELINE_SIZE, sizeof(struct deque));
+    long cap = 1;
+
+    while(cap < size) {
+        cap <<= 1;
+    }
+
+    dq->top = 0;
+    dq->bottom = 0;
+    dq->array = alloc_array(cap);
+    dq->ebr = ebr_create((free_fun_t) free_array);
+
+    return dq;
+}
+
+void d_destroy(struct deque* dq) {
+    free_array(dq->array);
+    ebr_destroy(dq->ebr);
+    free(dq);
+}
+
+static inline uval_t get(struct d_array* a, long i) {
+    return __atomic_load_n(&a->buf[i & a->mask], __ATOMIC_RELAXED);
+}
+
+static inline void put(struct d_array* a, long i, uval_t v) {
+    __atomic_store_n(&a->buf[i & a->mask], v, __ATOMIC_RELAXED);
+}
+
+/* owner only, copies [t, b) into an array twice as big */
+static struct d_array* grow(struct deque* dq, struct d_array* a, long t, long b, int tid) {
+    struct d_array* na = alloc_array(2 * (a->mask + 1));
+    long i;
+
+    for (i = t; i < b; i++) {
+        put(na, i, get(a, i));
+    }
+    __atomic_store_n(&dq->array, na, __ATOMIC_RELEASE);
+
+    /* thieves that loaded the old array may still read from it */
+    ebr_enter(dq->ebr, tid);
+    ebr_put(dq->ebr, a, tid);
+    ebr_exit(dq->ebr, tid);
+
+    return na;
+}
+
+void d_push(struct deque* dq, uval_t v, int tid) {
+    long b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    struct d_array* a = __atomic_load_n(&dq->array, __ATOMIC_RELAXED);
+
+    if (b - t > a->mask) {
+        a = grow(dq, a, t, b, tid);
+    }
+    put(a, b, v);
+    /* the item is visible before the thieves see the new bottom */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+}
+
+int d_pop(struct deque* dq, uval_t* v, int tid) {
+    long b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    struct d_array* a = __atomic_load_n(&dq->array, __ATOMIC_RELAXED);
+    long t;
+    int ret = 0;
+
+    /* claim the bottom item first, then look at top */
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        /* empty */
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return -ENOENT;
+    }
+
+    *v = get(a, b);
+    if (t == b) {
+        /* the last item, race the thieves for it on top */
+        if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            ret = -ENOENT;
+        }
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return ret;
+}
+
+int d_steal(struct deque* dq, uval_t* v, int tid) {
+    struct d_array* a;
+    long t, b;
+    int ret = -ENOENT;
+
+    ebr_enter(dq->ebr, tid);
+
+    t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+
+    if (t < b) {
+        /* consume, gcc promotes it to acquire anyway */
+        a = __atomic_load_n(&dq->array, __ATOMIC_ACQUIRE);
+        *v = get(a, t);
+        ret = __atomic_compare_exchange_n(&dq->top, &t, t + 1, 0,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) ? 0 : -EAGAIN;
+    }
+
+    ebr_exit(dq->ebr, tid);
+
+    return ret;
+}
@@ -0,0 +1,36 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include "util.h"
+#include "ebr.h"
+
+/*
+ * Chase-Lev work-stealing deque. the owner pushes and pops at bottom,
+ * any other thread steals at top. orderings follow Le et al., "Correct
+ * and Efficient Work-Stealing for Weak Memory Models". a full array is
+ * replaced by one twice as big, the old one is retired with EBR since
+ * thieves may still read it.
+ */
+struct d_array {
+    long mask;
+    uval_t buf[0];
+};
+
+struct deque {
+    /* thieves */
+    long top __attribute__((aligned(CACHELINE_SIZE)));
+    /* owner */
+    long bottom __attribute__((aligned(CACHELINE_SIZE)));
+    struct d_array* array;
+    struct ebr* ebr __attribute__((aligned(CACHELINE_SIZE)));
+};
+
+extern struct deque* d_create(int size);
+extern void d_destroy(struct deque* dq);
+/* owner only */
+extern void d_push(struct deque* dq, uval_t v, int tid);
+extern int d_pop(struct deque* dq, uval_t* v, int tid);
+/* any thread, -EAGAIN means another thread won the item */
+extern int d_steal(struct deque* dq, uval_t* v, int tid);
+
+#endif
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+
+#ifdef __APPLE__
+#include "pthread_barrier.h"
+#endif
+#include "deque.h"
+#include "atomic.h"
+
+#define N           10000000
+#define NUM_THREAD  8
+
+/* small, so the first phase has to grow the arrays */
+#define DQ_SIZE     64
+
+#define FIB_N       38
+#define FIB_CUTOFF  16
+
+#define RAND
+// #define DETAIL
+#define ASSERT
+
+#ifdef DETAIL
+#define test_print(fmt, args ...) do{printf(fmt, ##args);}while(0)
+#else
+#define test_print(fmt, args ...) do{}while(0)
+#endif
+
+#ifdef ASSERT
+#define test_assert(arg) do{assert(arg);}while(0)
+#else
+#define test_assert(arg) do{}while(0)
+#endif
+
+__thread struct timeval t0, t1;
+
+pthread_barrier_t barrier;
+pthread_t tids[NUM_THREAD];
+
+ukey_t k[N];
+uval_t v[N];
+
+struct deque* dqs[NUM_THREAD];
+
+uval_t taken;
+int owner_done[NUM_THREAD];
+
+/* fork-join fib, a task finishes when both children have added their result */
+struct task {
+    int n;
+    int pending;
+    long result;
+    struct task* parent;
+};
+
+int fib_done;
+long fib_result;
+
+static void gen_data() {
+    int i;
+
+    for (i = 0; i < N; i++) {
+        k[i] = i + 1;
+        v[i] = i + 1;
+    }
+
+#ifdef RAND
+    ukey_t temp_k;
+    uval_t temp_v;
+    int idx;
+
+    srand(time(0));
+    for (i = 0; i < N; i++) {
+        idx = rand() % N;
+        temp_k = k[i];
+        k[i] = k[idx];
+        k[idx] = temp_k;
+        temp_v = v[i];
+        v[i] = v[idx];
+        v[idx] = temp_v;
+    }
+#endif
+}
+
+static void start_measure() {
+    gettimeofday(&t0, NULL);
+}
+
+static double end_measure() {
+    gettimeofday(&t1, NULL);
+    return t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) / 1e6;
+}
+
+static void do_barrier(long id, const char* arg) {
+    pthread_barrier_wait(&barrier);
+    if (id == 0) {
+        printf("%s finished in %.3lf seconds\n", arg, end_measure());
+    }
+}
+
+/* every thread on its own deque, pops come back in reverse */
+static void do_push_pop(long id) {
+    int st, ed, i;
+    uval_t v0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        d_push(dqs[id], v[i], (int) id);
+    }
+    for (i = ed - 1; i >= st; i--) {
+        test_assert(d_pop(dqs[id], &v0, (int) id) == 0);
+        test_assert(v0 == v[i]);
+    }
+    test_assert(d_pop(dqs[id], &v0, (int) id) == -ENOENT);
+}
+
+/* the owner pushes its slice, then pops until empty */
+static void do_owner(long id) {
+    int st, ed, i;
+    uval_t v0, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / (NUM_THREAD / 2) * N;
+    ed = 1.0 * (id + 1) / (NUM_THREAD / 2) * N;
+
+    for (i = st; i < ed; i++) {
+        d_push(dqs[id], v[i], (int) id);
+    }
+    while(!d_pop(dqs[id], &v0, (int) id)) {
+        sum += v0;
+    }
+
+    xadd(&taken, sum);
+    ACCESS_ONCE(owner_done[id]) = 1;
+}
+
+/* the thief steals from the owner's deque until the owner is done and it is empty */
+static void do_thief(long id) {
+    struct deque* dq = dqs[id - NUM_THREAD / 2];
+    int *done = &owner_done[id - NUM_THREAD / 2], finished, ret;
+    uval_t v0, sum = 0;
+
+    start_measure();
+
+    while(1) {
+        finished = ACCESS_ONCE(*done);
+        ret = d_steal(dq, &v0, (int) id);
+        if (!ret) {
+            sum += v0;
+        } else if (ret == -ENOENT && finished) {
+            break;
+        }
+    }
+
+    xadd(&taken, sum);
+}
+
+static long fib(int n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+static struct task* new_task(int n, struct task* parent) {
+    struct task* t = (struct task*) malloc(sizeof(struct task));
+
+    t->n = n;
+    t->pending = 0;
+    t->result = 0;
+    t->parent = parent;
+
+    return t;
+}
+
+/* fold the result into the parents that are complete now */
+static void complete(struct task* t) {
+    struct task* p;
+
+    while((p = t->parent)) {
+        xadd(&p->result, t->result);
+        free(t);
+        if (xadd(&p->pending, -1)) {
+            return;
+        }
+        t = p;
+    }
+
+    fib_result = t->result;
+    free(t);
+    barrier();
+    ACCESS_ONCE(fib_done) = 1;
+}
+
+static void run_task(struct task* t, long id) {
+    while(t->n >= FIB_CUTOFF) {
+        t->pending = 2;
+        /* one child for the thieves, go on with the other */
+        d_push(dqs[id], (uval_t) new_task(t->n - 1, t), (int) id);
+        t = new_task(t->n - 2, t);
+    }
+    t->result = fib(t->n);
+    complete(t);
+}
+
+static void do_fib(long id) {
+    unsigned int seed = id + 1, fails = 0;
+    uval_t t;
+
+    start_measure();
+
+    if (id == 0) {
+        run_task(new_task(FIB_N, NULL), id);
+    }
+
+    while(!ACCESS_ONCE(fib_done)) {
+        if (!d_pop(dqs[id], &t, (int) id)) {
+            run_task((struct task*) t, id);
+            continue;
+        }
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        if (!d_steal(dqs[seed % NUM_THREAD], &t, (int) id)) {
+            run_task((struct task*) t, id);
+            continue;
+        }
+        if (++fails % 64 == 0) {
+            sched_yield();
+        }
+    }
+}
+
+void* test_fun(void* arg) {
+    long id = (long) arg;
+
+    do_push_pop(id);
+
+    do_barrier(id, "PUSH & POP");
+
+    if (id < NUM_THREAD / 2) {
+        do_owner(id);
+    } else {
+        do_thief(id);
+    }
+
+    do_barrier(id, "PUSH & STEAL");
+
+    do_fib(id);
+
+    do_barrier(id, "FIB");
+
+    return NULL;
+}
+
+int main() {
+    long i, j;
+    uval_t sum = 0;
+
+    gen_data();
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        dqs[i] = d_create(DQ_SIZE);
+    }
+
+    pthread_barrier_init(&barrier, NULL, NUM_THREAD);
+
+    /* thieves enter other threads' deques */
+    for (i = 0; i < NUM_THREAD; i++) {
+        for (j = 0; j < NUM_THREAD; j++) {
+            ebr_thread_register(dqs[i]->ebr, j);
+        }
+    }
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_create(&tids[i], NULL, test_fun, (void*) i);
+    }
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    for (i = 0; i < N; i++) {
+        sum += v[i];
+    }
+    test_assert(taken == sum);
+    test_assert(fib_result == fib(FIB_N));
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        d_destroy(dqs[i]);
+    }
+
+    return 0;
+}
@@ -2,168 +2,446 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
 
 #include "heap.h"
 
-static inline void h_swap(struct h_node* a, struct h_node* b) {
+/* the longest run h_push_batch() tags at once, tid + run * MAX_NUM_THREADS fits in h_node.tid */
+#define H_PUSH_BATCH_MAX    ((1 << 29) / MAX_NUM_THREADS - 1)
+
+static inline void h_lock(struct heap* h) {
+    tas_lock(&h->lock);
+    h->nr_locks++;
+}
+
+/* swap the items of the locked nodes a and b, at index ia and ib */
+static inline void h_swap(struct heap* h, struct h_node* a, int ia, struct h_node* b, int ib) {
     struct h_node t;
-    /*memcpy spinlock is dangerous, could cause unexpected dead-lock*/
-    int size = sizeof(struct h_node) - sizeof(spinlock_t);
+    struct h_cold *ca = h_cold(h, ia), *cb = h_cold(h, ib), ct;
+    /*memcpy a lock is dangerous, could cause unexpected dead-lock*/
+    int size = offsetof(struct h_node, lock);
 
     memcpy(&t, a, size);
     memcpy(a, b, size);
     memcpy(b, &t, size);
+
+    ct = *ca;
+    *ca = *cb;
+    *cb = ct;
+
+    if (ca->hd) {
+        ca->hd->idx = ia;
+    }
+    if (cb->hd) {
+        cb->hd->idx = ib;
+    }
 }
 
-extern struct heap* h_create(int size) {
-    /*size to be an odd to prevent SEG_FAULT when access right child*/
-    if (!(size & 1)) {
-        size++;
+/* called with h->lock held, readers only index below h->len < h->size */
+static int h_grow(struct heap* h) {
+    struct h_node* chunk;
+    struct h_cold* cold;
+    int c = h->nr_chunks, n, i;
+
+    if (c == H_MAX_CHUNKS) {
+        return -ENOBUFS;
     }
-    int h_size = sizeof(struct heap) + size * sizeof(struct h_node);
-    struct heap* h = (struct heap*) malloc(h_size);
-    int i;
-    
-    h->size = size;
-    h->len = 0;
-    spin_lock_init(&h->lock);
 
-    for (i = 0; i < size; i++) {
-        spin_lock_init(&h->nodes[i].lock);
-        h->nodes[i].tag = EMPTY;
-        h->nodes[i].tid = -1;
+    n = H_CHUNK0 << c;
+    chunk = (struct h_node*) aligned_alloc(CACHELINE_SIZE, n * sizeof(struct h_node));
+    cold = (struct h_cold*) malloc(n * sizeof(struct h_cold));
+    if (!chunk || !cold) {
+        free(chunk);
+        free(cold);
+        return -ENOBUFS;
+    }
+    for (i = 0; i < n; i++) {
+        tas_lock_init(&chunk[i].lock);
+        chunk[i].tag = EMPTY;
+        chunk[i].tid = -1;
+        cold[i].hd = NULL;
     }
 
+    h->chunks[c] = chunk;
+    h->colds[c] = cold;
+    barrier();
+    h->nr_chunks = c + 1;
+    /* the first H_ARITY - 1 slots only pad the sibling groups */
+    ACCESS_ONCE(h->size) = h->size + (c ? n : n - (H_ARITY - 1));
+
+    return 0;
+}
+
+/* size is only a hint now, the heap grows a chunk at a time */
+extern struct heap* h_create(int size) {
+    struct heap* h = (struct heap*) malloc(sizeof(struct heap));
+
+    h->size = 0;
+    h->len = 0;
+    h->nr_locks = 0;
+    h->nr_chunks = 0;
+    tas_lock_init(&h->lock);
+
+    do {
+        h_grow(h);
+    } while(h->size < size && h->nr_chunks < H_MAX_CHUNKS);
+
     return h;
 }
 
 extern void h_destroy(struct heap* h) {
+    int i;
+
+    for (i = 0; i < h->nr_chunks; i++) {
+        free(h->chunks[i]);
+        free(h->colds[i]);
+    }
     free(h);
 }
 
-extern int h_push(struct heap* h, ukey_t k, int tid) {
-    int now, fa, prev;
-    struct h_node* nodes = h->nodes;
+/* called with h->lock held, the new item is BUSY until sift_up() is done */
+static void h_place(struct heap* h, int i, ukey_t k, uval_t v, struct h_handle* hd, int tid) {
+    struct h_node* node = h_node(h, i);
+    struct h_cold* cold = h_cold(h, i);
 
-    spin_lock(&h->lock);
-    if (h->len == h->size) {
-        spin_unlock(&h->lock);
-        return -ENOBUFS;
+    tas_lock(&node->lock);
+    node->k = k;
+    cold->v = v;
+    cold->hd = hd;
+    node->tag = BUSY;
+    node->tid = tid;
+    if (hd) {
+        hd->idx = i;
     }
-    now = h->len++;
-    spin_lock(&nodes[now].lock);
-    nodes[now].k = k;
-    nodes[now].tag = BUSY;
-    nodes[now].tid = tid;
-    spin_unlock(&nodes[now].lock);
-    spin_unlock(&h->lock);
-    
+    tas_unlock(&node->lock);
+}
+
+/*
+ * carry the BUSY item tagged tid up from now. pops may move it up
+ * meanwhile, so it is looked for on the way. tid only has to tell
+ * in-flight items apart, it needs not be a thread id.
+ */
+static void sift_up(struct heap* h, int now, int tid) {
+    struct h_node *node, *fa_node;
+    int fa;
+
     /*root_id is 0*/
-    /*father: i, child: (2 * i + 1), (2 * i + 2)*/
+    /*father: i, child: (H_ARITY * i + 1) .. (H_ARITY * i + H_ARITY)*/
     while(now > 0) {
-        fa = (now - 1) / 2;
-        spin_lock(&nodes[fa].lock);
-        spin_lock(&nodes[now].lock);
-        prev = now;
-        if (nodes[fa].tag == AVAIL && 
-        nodes[now].tag == BUSY && nodes[now].tid == tid) {
-            if (k_cmp(nodes[now].k, nodes[fa].k) < 0) {
-                h_swap(&nodes[now], &nodes[fa]);
+        fa = (now - 1) / H_ARITY;
+        fa_node = h_node(h, fa);
+        node = h_node(h, now);
+        tas_lock(&fa_node->lock);
+        tas_lock(&node->lock);
+        if (fa_node->tag == AVAIL && 
+        node->tag == BUSY && node->tid == tid) {
+            if (k_cmp(node->k, fa_node->k) < 0) {
+                h_swap(h, node, now, fa_node, fa);
                 now = fa;
             } else {
-                nodes[now].tag = AVAIL;
-                nodes[now].tid = -1;
-                spin_unlock(&nodes[fa].lock);
-                spin_unlock(&nodes[prev].lock);
-                return 0;
+                node->tag = AVAIL;
+                node->tid = -1;
+                tas_unlock(&fa_node->lock);
+                tas_unlock(&node->lock);
+                return;
             }
-        } else if (nodes[now].tag != BUSY || nodes[now].tid != tid) {
+        } else if (node->tag != BUSY || node->tid != tid) {
             /*node[now] has been moved uppon*/
             now = fa;
         }
-        spin_unlock(&nodes[fa].lock);
-        spin_unlock(&nodes[prev].lock);
+        tas_unlock(&fa_node->lock);
+        tas_unlock(&node->lock);
     }
 
     if (now == 0) {
-        spin_lock(&nodes[0].lock);
-        if (nodes[0].tag == BUSY && nodes[0].tid == tid) {
-            nodes[0].tag = AVAIL;
-            nodes[now].tid = -1;
+        node = h_node(h, 0);
+        tas_lock(&node->lock);
+        if (node->tag == BUSY && node->tid == tid) {
+            node->tag = AVAIL;
+            node->tid = -1;
         }
-        spin_unlock(&nodes[0].lock);
+        tas_unlock(&node->lock);
+    }
+}
+
+extern int h_push_handle(struct heap* h, ukey_t k, uval_t v, struct h_handle* hd, int tid) {
+    int now;
+
+    h_lock(h);
+    if (h->len == h->size && h_grow(h)) {
+        tas_unlock(&h->lock);
+        return -ENOBUFS;
     }
+    now = h->len++;
+    h_place(h, now, k, v, hd, tid);
+    tas_unlock(&h->lock);
+
+    sift_up(h, now, tid);
 
     return 0;
 }
 
-extern int h_pop(struct heap* h, ukey_t *k) {
-    int last, left, right, child, now;
-    struct h_node* nodes = h->nodes;
+extern int h_push(struct heap* h, ukey_t k, uval_t v, int tid) {
+    return h_push_handle(h, k, v, NULL, tid);
+}
 
-    spin_lock(&h->lock);
-    if (!h->len) {
-        spin_unlock(&h->lock);
-        return -ENONET;
+/* place the run under one h->lock, then sift the items up one by one */
+static int push_run(struct heap* h, entry_t* e_arr, int len, int tid) {
+    int st, cnt, i;
+
+    h_lock(h);
+    st = h->len;
+    for (cnt = 0; cnt < len; cnt++) {
+        if (h->len == h->size && h_grow(h)) {
+            break;
+        }
+        /* every in-flight item needs its own tag */
+        h_place(h, h->len++, e_arr[cnt].k, e_arr[cnt].v, NULL, tid + (cnt + 1) * MAX_NUM_THREADS);
     }
-    last = --h->len;
-    spin_lock(&nodes[0].lock);
-    *k = nodes[0].k;
-    if (last == 0) {
-        spin_unlock(&h->lock);
-        spin_unlock(&nodes[0].lock);
-        return 0;
+    tas_unlock(&h->lock);
+
+    /* parents come first, so an item never waits on a BUSY parent of its own batch */
+    for (i = 0; i < cnt; i++) {
+        sift_up(h, st + i, tid + (i + 1) * MAX_NUM_THREADS);
     }
-    spin_lock(&nodes[last].lock);
-    spin_unlock(&h->lock);
-    nodes[0].tag = EMPTY;
-    nodes[0].tid = -1;
-    h_swap(&nodes[0], &nodes[last]);
-    spin_unlock(&nodes[last].lock);
-    assert(nodes[0].tag != EMPTY);
-    
-    /*node[0] is still locked*/
-    now = 0;
-    while(now * 2 + 2 < h->len) {
-        left = now * 2 + 1;
-        right = now * 2 + 2;
-        spin_lock(&nodes[left].lock);
-        spin_lock(&nodes[right].lock);
-        if (nodes[left].tag == EMPTY) {
-            spin_unlock(&nodes[left].lock);
-            spin_unlock(&nodes[right].lock);
+
+    return cnt;
+}
+
+/* a longer batch goes in runs of H_PUSH_BATCH_MAX, each run is done before the next */
+extern int h_push_batch(struct heap* h, entry_t* e_arr, int len, int tid) {
+    int done = 0, run, cnt;
+
+    while(done < len) {
+        run = len - done < H_PUSH_BATCH_MAX ? len - done : H_PUSH_BATCH_MAX;
+        cnt = push_run(h, e_arr + done, run, tid);
+        done += cnt;
+        if (cnt < run) {
             break;
-        } else if (nodes[right].tag == EMPTY || 
-        k_cmp(nodes[left].k, nodes[right].k) < 0) {
-            spin_unlock(&nodes[right].lock);
-            child = left;
-        } else {
-            spin_unlock(&nodes[left].lock);
-            child = right;
         }
+    }
+
+    return (len && !done) ? -ENOBUFS : done;
+}
+
+/*
+ * node is locked and holds the item moved up from the last slot. siblings
+ * sit in one group, they are locked left to right and only the smallest
+ * so far stays locked. keep, if not NULL, is left locked for the caller.
+ */
+static void sift_down(struct heap* h, struct h_node* node, struct h_node* keep) {
+    struct h_node *sibling, *child;
+    int now = 0, first, last, child_idx, i;
+
+    while(1) {
+        first = now * H_ARITY + 1;
+        last = ACCESS_ONCE(h->len);
+        if (first >= last) {
+            break;
+        }
+        if (last > first + H_ARITY) {
+            last = first + H_ARITY;
+        }
+
+        /* a group never straddles two chunks */
+        sibling = h_node(h, first);
+        child = NULL;
+        child_idx = -1;
+        for (i = first; i < last; i++, sibling++) {
+            tas_lock(&sibling->lock);
+            /*slots past h->len are EMPTY*/
+            if (sibling->tag == EMPTY) {
+                tas_unlock(&sibling->lock);
+                break;
+            }
+            if (!child || k_cmp(sibling->k, child->k) < 0) {
+                if (child) {
+                    tas_unlock(&child->lock);
+                }
+                child = sibling;
+                child_idx = i;
+            } else {
+                tas_unlock(&sibling->lock);
+            }
+        }
+        if (!child) {
+            break;
+        }
+
         /*pop() will not be delayed when add() is moving a node*/
-        if (k_cmp(nodes[child].k, nodes[now].k) < 0) {
-            h_swap(&nodes[child], &nodes[now]);
-            spin_unlock(&nodes[now].lock);
-            now = child;
+        if (k_cmp(child->k, node->k) < 0) {
+            h_swap(h, child, child_idx, node, now);
+            if (node != keep) {
+                tas_unlock(&node->lock);
+            }
+            node = child;
+            now = child_idx;
         } else {
-            spin_unlock(&nodes[child].lock);
+            tas_unlock(&child->lock);
             break;
         }
     }
-    spin_unlock(&nodes[now].lock);
+    if (node != keep) {
+        tas_unlock(&node->lock);
+    }
+}
+
+/* called with h->lock held on a non-empty heap, drops it as early as possible */
+static void pop_root(struct heap* h, ukey_t *k, uval_t *v) {
+    struct h_node *node, *last_node;
+    struct h_cold* cold;
+    int last;
+
+    last = --h->len;
+    node = h_node(h, 0);
+    cold = h_cold(h, 0);
+    tas_lock(&node->lock);
+    *k = node->k;
+    *v = cold->v;
+    if (cold->hd) {
+        cold->hd->idx = -1;
+        cold->hd = NULL;
+    }
+    if (last == 0) {
+        node->tag = EMPTY;
+        node->tid = -1;
+        tas_unlock(&h->lock);
+        tas_unlock(&node->lock);
+        return;
+    }
+    last_node = h_node(h, last);
+    tas_lock(&last_node->lock);
+    tas_unlock(&h->lock);
+    node->tag = EMPTY;
+    node->tid = -1;
+    h_swap(h, node, 0, last_node, last);
+    tas_unlock(&last_node->lock);
+    assert(node->tag != EMPTY);
+    /*
+     * the sift-down below may move an in-flight push downwards, where its
+     * pusher walking up would never find it again. publish it now, the
+     * pusher then climbs to the root and finds nothing left to do.
+     */
+    if (node->tag == BUSY) {
+        node->tag = AVAIL;
+        node->tid = -1;
+    }
+
+    /*node[0] is still locked*/
+    sift_down(h, node, NULL);
+}
+
+extern int h_pop(struct heap* h, ukey_t *k, uval_t *v) {
+    h_lock(h);
+    if (!h->len) {
+        tas_unlock(&h->lock);
+        return -ENOENT;
+    }
+    pop_root(h, k, v);
 
     return 0;
 }
 
-extern int h_top(struct heap* h, ukey_t *k) {
-    spin_lock(&h->lock);
+/*
+ * the whole batch under one hold of h->lock and node[0]: take the root,
+ * move the last item up and sift it down, then the next root. in-flight
+ * pushes climbing to the root wait for the batch at node[0].
+ */
+extern int h_pop_batch(struct heap* h, entry_t* e_arr, int len) {
+    struct h_node *root, *last_node;
+    struct h_cold* cold;
+    int cnt, last;
+
+    h_lock(h);
+    root = h_node(h, 0);
+    cold = h_cold(h, 0);
+    tas_lock(&root->lock);
+
+    for (cnt = 0; cnt < len && h->len; cnt++) {
+        last = --h->len;
+        e_arr[cnt].k = root->k;
+        e_arr[cnt].v = cold->v;
+        if (cold->hd) {
+            cold->hd->idx = -1;
+            cold->hd = NULL;
+        }
+        root->tag = EMPTY;
+        root->tid = -1;
+        if (last == 0) {
+            continue;
+        }
+
+        last_node = h_node(h, last);
+        tas_lock(&last_node->lock);
+        h_swap(h, root, 0, last_node, last);
+        tas_unlock(&last_node->lock);
+        /* same as in pop_root() */
+        if (root->tag == BUSY) {
+            root->tag = AVAIL;
+            root->tid = -1;
+        }
+        sift_down(h, root, root);
+    }
+
+    tas_unlock(&root->lock);
+    tas_unlock(&h->lock);
+
+    return (len && !cnt) ? -ENOENT : cnt;
+}
+
+extern int h_top(struct heap* h, ukey_t *k, uval_t *v) {
+    struct h_node* node;
+
+    h_lock(h);
     if (!h->len) {
-        spin_unlock(&h->lock);
-        return -ENONET;
+        tas_unlock(&h->lock);
+        return -ENOENT;
+    }
+    node = h_node(h, 0);
+    tas_lock(&node->lock);
+    *k = node->k;
+    *v = h_cold(h, 0)->v;
+    tas_unlock(&node->lock);
+    tas_unlock(&h->lock);
+    return 0;
+}
+
+/* only lowers the key, the item is then carried up like a fresh push */
+extern int h_decrease_key(struct heap* h, struct h_handle* hd, ukey_t k, int tid) {
+    struct h_node* node;
+    int idx;
+
+    /* the item may move between reading its index and locking its node */
+    while(1) {
+        idx = ACCESS_ONCE(hd->idx);
+        if (idx < 0) {
+            return -ENOENT;
+        }
+        node = h_node(h, idx);
+        tas_lock(&node->lock);
+        if (h_cold(h, idx)->hd == hd) {
+            break;
+        }
+        tas_unlock(&node->lock);
     }
-    *k = h->nodes[0].k;
-    spin_unlock(&h->lock);
+
+    if (k_cmp(k, node->k) > 0) {
+        tas_unlock(&node->lock);
+        return -EINVAL;
+    }
+    node->k = k;
+
+    /* still on its way up with its pusher, which will see the new key */
+    if (node->tag == BUSY) {
+        tas_unlock(&node->lock);
+        return 0;
+    }
+    node->tag = BUSY;
+    node->tid = tid;
+    tas_unlock(&node->lock);
+
+    sift_up(h, idx, tid);
+
     return 0;
 }
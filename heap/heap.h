@@ -2,7 +2,7 @@
 #define HEAP_H
 
 #include "util.h"
-#include "spinlock.h"
+#include "taslock.h"
 
 typedef enum {
     EMPTY = 0,
@@ -10,25 +10,78 @@ typedef enum {
     BUSY
 }status;
 
+/* follows an item around the heap, for h_decrease_key */
+struct h_handle {
+    int idx;
+};
+
+/*
+ * hot part of an item, all a sift looks at. 16 bytes, so the children of
+ * a 4-ary node share one cache line.
+ */
 struct h_node {
-    status tag;
     ukey_t k;
-    int tid;
-    spinlock_t lock;
+    unsigned int tag : 2;
+    int tid : 30;
+    /* keep it last, h_swap leaves it in place */
+    tas_lock_t lock;
 };
 
+/* cold part, only touched when an item moves or leaves */
+struct h_cold {
+    uval_t v;
+    struct h_handle* hd;
+};
+
+/* children of node i are H_ARITY * i + 1 .. H_ARITY * i + H_ARITY */
+#ifndef H_ARITY
+#define H_ARITY         2
+#endif
+
+/* chunk c holds H_CHUNK0 << c nodes, nodes never move once allocated */
+#define H_CHUNK0_SHIFT  6
+#define H_CHUNK0        (1 << H_CHUNK0_SHIFT)
+#define H_MAX_CHUNKS    25
+
 struct heap {
     int size;
     int len;
-    spinlock_t lock;
+    tas_lock_t lock;
+    /* times h->lock was taken, bumped under it */
+    unsigned long nr_locks;
 
-    struct h_node nodes[0];
+    int nr_chunks;
+    struct h_node* chunks[H_MAX_CHUNKS];
+    struct h_cold* colds[H_MAX_CHUNKS];
 };
 
+/*
+ * node i lives at slot i + H_ARITY - 1 + H_CHUNK0, which puts every group
+ * of siblings at a multiple of H_ARITY, aligned and inside one chunk.
+ * the top bit of the slot picks the chunk.
+ */
+#define h_slot_of(i, array) ({                                          \
+    unsigned long __slot = (unsigned long) (i) + H_ARITY - 1 + H_CHUNK0; \
+    int __top = 63 - __builtin_clzl(__slot);                            \
+    &(array)[__top - H_CHUNK0_SHIFT][__slot - (1UL << __top)];          \
+})
+
+static inline struct h_node* h_node(struct heap* h, int i) {
+    return h_slot_of(i, h->chunks);
+}
+
+static inline struct h_cold* h_cold(struct heap* h, int i) {
+    return h_slot_of(i, h->colds);
+}
+
 extern struct heap* h_create(int size);
 extern void h_destroy(struct heap* h);
-extern int h_push(struct heap* h, ukey_t k, int tid);
-extern int h_pop(struct heap* h, ukey_t *k);
-extern int h_top(struct heap* h, ukey_t *k);
+extern int h_push(struct heap* h, ukey_t k, uval_t v, int tid);
+extern int h_push_handle(struct heap* h, ukey_t k, uval_t v, struct h_handle* hd, int tid);
+extern int h_push_batch(struct heap* h, entry_t* e_arr, int len, int tid);
+extern int h_pop(struct heap* h, ukey_t *k, uval_t *v);
+extern int h_pop_batch(struct heap* h, entry_t* e_arr, int len);
+extern int h_top(struct heap* h, ukey_t *k, uval_t *v);
+extern int h_decrease_key(struct heap* h, struct h_handle* hd, ukey_t k, int tid);
 
 #endif
\ No newline at end of file
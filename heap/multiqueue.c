@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "multiqueue.h"
+
+static __thread unsigned int mq_seed;
+
+/* xorshift, rand() would serialize all threads on the libc lock */
+static inline int mq_rand(int n) {
+    if (unlikely(!mq_seed)) {
+        mq_seed = (unsigned int) time(0) ^ (unsigned int) (unsigned long) &mq_seed;
+        mq_seed |= 1;
+    }
+    mq_seed ^= mq_seed << 13;
+    mq_seed ^= mq_seed >> 17;
+    mq_seed ^= mq_seed << 5;
+
+    return mq_seed % n;
+}
+
+/* called with lane->lock held, so nothing moves inside the heap */
+static inline void update_top(struct mq_lane* lane) {
+    if (lane->h->len) {
+        ACCESS_ONCE(lane->top) = h_node(lane->h, 0)->k;
+    }
+    ACCESS_ONCE(lane->len) = lane->h->len;
+}
+
+/* 1 if lane a has the smaller top, an empty lane loses to any other */
+static inline int lane_before(struct mq_lane* a, struct mq_lane* b) {
+    if (!ACCESS_ONCE(a->len)) {
+        return 0;
+    }
+    return !ACCESS_ONCE(b->len) || k_cmp(ACCESS_ONCE(a->top), ACCESS_ONCE(b->top)) < 0;
+}
+
+extern struct mq* mq_create(int nr_lanes, int size) {
+    struct mq* mq = (struct mq*) aligned_alloc(CACHELINE_SIZE,
+                    sizeof(struct mq) + nr_lanes * sizeof(struct mq_lane));
+    int i;
+
+    mq->nr_lanes = nr_lanes;
+    for (i = 0; i < nr_lanes; i++) {
+        tas_lock_init(&mq->lanes[i].lock);
+        mq->lanes[i].len = 0;
+        mq->lanes[i].top = 0;
+        mq->lanes[i].h = h_create(size / nr_lanes + 1);
+    }
+
+    return mq;
+}
+
+extern void mq_destroy(struct mq* mq) {
+    int i;
+
+    for (i = 0; i < mq->nr_lanes; i++) {
+        h_destroy(mq->lanes[i].h);
+    }
+    free(mq);
+}
+
+extern int mq_push(struct mq* mq, ukey_t k, uval_t v, int tid) {
+    struct mq_lane* lane;
+    int full = 0, ret;
+
+    /* give up once as many full lanes as there are lanes were hit */
+    while(full < mq->nr_lanes) {
+        lane = &mq->lanes[mq_rand(mq->nr_lanes)];
+        if (!tas_trylock(&lane->lock)) {
+            continue;
+        }
+        ret = h_push(lane->h, k, v, tid);
+        update_top(lane);
+        tas_unlock(&lane->lock);
+
+        if (ret != -ENOBUFS) {
+            return ret;
+        }
+        full++;
+    }
+
+    return -ENOBUFS;
+}
+
+extern int mq_pop(struct mq* mq, ukey_t *k, uval_t *v) {
+    struct mq_lane *lane, *other;
+    int ret, i;
+
+    while(1) {
+        lane = &mq->lanes[mq_rand(mq->nr_lanes)];
+        other = &mq->lanes[mq_rand(mq->nr_lanes)];
+        if (lane_before(other, lane)) {
+            lane = other;
+        }
+
+        /* both picks are empty, look at every lane before giving up */
+        if (!ACCESS_ONCE(lane->len)) {
+            for (i = 0; i < mq->nr_lanes; i++) {
+                if (ACCESS_ONCE(mq->lanes[i].len)) {
+                    lane = &mq->lanes[i];
+                    break;
+                }
+            }
+            if (i == mq->nr_lanes) {
+                return -ENOENT;
+            }
+        }
+
+        if (!tas_trylock(&lane->lock)) {
+            continue;
+        }
+        ret = h_pop(lane->h, k, v);
+        update_top(lane);
+        tas_unlock(&lane->lock);
+
+        if (!ret) {
+            return 0;
+        }
+    }
+}
+
+/* the smallest top seen, lanes may change while they are scanned */
+extern int mq_top(struct mq* mq, ukey_t *k, uval_t *v) {
+    struct mq_lane* lane;
+    int i, ret;
+
+    while(1) {
+        lane = NULL;
+        for (i = 0; i < mq->nr_lanes; i++) {
+            if (ACCESS_ONCE(mq->lanes[i].len) && (!lane || lane_before(&mq->lanes[i], lane))) {
+                lane = &mq->lanes[i];
+            }
+        }
+        if (!lane) {
+            return -ENOENT;
+        }
+
+        /* the value is only stable under the lane lock, a busy lane is scanned again */
+        if (!tas_trylock(&lane->lock)) {
+            continue;
+        }
+        ret = h_top(lane->h, k, v);
+        tas_unlock(&lane->lock);
+
+        /* drained since the scan, look again */
+        if (!ret) {
+            return 0;
+        }
+    }
+}
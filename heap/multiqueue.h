@@ -0,0 +1,38 @@
+#ifndef MULTIQUEUE_H
+#define MULTIQUEUE_H
+
+#include "util.h"
+#include "taslock.h"
+#include "heap.h"
+
+/* queues per thread */
+#define MQ_C        2
+
+/*
+ * a heap, the lock that serializes it and its length and top key readable
+ * without the lock. emptiness is told by len, any key is a valid top.
+ */
+struct mq_lane {
+    tas_lock_t lock;
+    int len;
+    ukey_t top;
+    struct heap* h;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+/*
+ * relaxed priority queue: a push goes to a random lane, a pop takes the
+ * smaller top of two random lanes. lanes are only ever try-locked, a busy
+ * lane just means picking another one.
+ */
+struct mq {
+    int nr_lanes;
+    struct mq_lane lanes[0];
+};
+
+extern struct mq* mq_create(int nr_lanes, int size);
+extern void mq_destroy(struct mq* mq);
+extern int mq_push(struct mq* mq, ukey_t k, uval_t v, int tid);
+extern int mq_pop(struct mq* mq, ukey_t *k, uval_t *v);
+extern int mq_top(struct mq* mq, ukey_t *k, uval_t *v);
+
+#endif
@@ -10,13 +10,21 @@
 #ifdef __APPLE__
 #include "pthread_barrier.h"
 #endif
+#include "atomic.h"
 #include "heap.h"
+#include "multiqueue.h"
 
 #define N           10000000
 /*NUM_THREAD HAS TO BE AN ODD*/
 #define NUM_THREAD  8
 
+/* initial capacity, the heap grows past it */
 #define POOL_SIZE   10000
+/* keys 1 .. MQ_N go through the multiqueue */
+#define MQ_N        (N / 10)
+#define H_BATCH     64
+/* items pushed with handles and then decreased */
+#define DK_N        (N / 10)
 
 #define RAND
 // #define DETAIL
@@ -44,6 +52,15 @@ ukey_t k[N];
 uval_t v[N];
 
 struct heap* h;
+struct mq* mq;
+
+int h_popped;
+struct h_handle hds[DK_N];
+
+/* popped keys in pop order, and a fenwick tree over the keys to rank them */
+int pop_seq;
+ukey_t pop_log[MQ_N];
+int fenwick[MQ_N + 1];
 
 static void gen_data() {
     int i;
@@ -97,7 +114,7 @@ static void do_push(long id, int expect_ret) {
     ed = 1.0 * (id + 1) / NUM_THREAD * N;
 
     for (i = st; i < ed; i++) {
-        h_push(h, v[i], id);
+        ret = h_push(h, k[i], v[i], id);
         test_assert(expect_ret == -1 || ret == expect_ret);
     }
 
@@ -108,7 +125,8 @@ static void do_push(long id, int expect_ret) {
 static void do_pop(long id, int expect_ret) {
     int st, ed, i, ret;
     double interval;
-    uval_t v;
+    ukey_t key;
+    uval_t val;
 
     start_measure();
 
@@ -116,20 +134,239 @@ static void do_pop(long id, int expect_ret) {
     ed = 1.0 * (id + 1) / NUM_THREAD * N;
 
     for (i = st; i < ed; i++) {
-        h_pop(h, &v);
+        ret = h_pop(h, &key, &val);
         test_assert(expect_ret == -1 || ret == expect_ret);
+        if (ret == 0) {
+            test_assert(key == val);
+            xadd(&h_popped, 1);
+        }
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+static void do_push_batch(long id) {
+    entry_t batch[H_BATCH];
+    int st, ed, i, j, ret;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i += j) {
+        for (j = 0; j < H_BATCH && i + j < ed; j++) {
+            batch[j].k = k[i + j];
+            batch[j].v = v[i + j];
+        }
+        ret = h_push_batch(h, batch, j, id);
+        test_assert(ret == j);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+static void do_pop_batch(long id) {
+    entry_t batch[H_BATCH];
+    int st, ed, i, j, ret;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i += H_BATCH) {
+        ret = h_pop_batch(h, batch, H_BATCH);
+        if (ret > 0) {
+            for (j = 0; j < ret; j++) {
+                test_assert(batch[j].k == batch[j].v);
+            }
+            xadd(&h_popped, ret);
+        }
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+/* a batch takes h->lock once, as many h_pop() calls would take it len times */
+static void pop_batch_locks() {
+    entry_t batch[H_BATCH];
+    unsigned long locks;
+    int i, ret;
+
+    h = h_create(POOL_SIZE);
+    for (i = 0; i < 4 * H_BATCH; i++) {
+        test_assert(h_push(h, k[i], v[i], 0) == 0);
+    }
+
+    locks = h->nr_locks;
+    ret = h_pop_batch(h, batch, H_BATCH);
+    test_assert(ret == H_BATCH);
+    test_assert(h->nr_locks - locks == 1);
+    for (i = 1; i < ret; i++) {
+        test_assert(batch[i - 1].k < batch[i].k);
+    }
+    test_assert(h->len == 3 * H_BATCH);
+
+    printf("POP BATCH of %d took h->lock %lu times\n", ret, h->nr_locks - locks);
+
+    h_destroy(h);
+}
+
+/* push far behind the real key, then bring every item forward */
+static void do_decrease_key(long id) {
+    int st, ed, i, ret;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * DK_N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * DK_N;
+
+    for (i = st; i < ed; i++) {
+        ret = h_push_handle(h, k[i] + N, v[i], &hds[i], id);
+        test_assert(ret == 0);
+    }
+
+    do_barrier(id, "PUSH HANDLE");
+
+    start_measure();
+
+    for (i = st; i < ed; i++) {
+        ret = h_decrease_key(h, &hds[i], k[i], id);
+        test_assert(ret == 0);
     }
 
     interval = end_measure();
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
 }
 
+static void check_decreased() {
+    ukey_t key, last = 0;
+    uval_t val;
+    int cnt = 0, i;
+
+    start_measure();
+
+    while(h_pop(h, &key, &val) == 0) {
+        test_assert(key == val && k_cmp(key, last) > 0);
+        last = key;
+        cnt++;
+    }
+    test_assert(cnt == DK_N);
+
+    printf("DRAIN finished in %.3lf seconds\n", end_measure());
+
+    for (i = 0; i < DK_N; i++) {
+        test_assert(hds[i].idx == -1);
+    }
+}
+
+static void do_mq_push(long id) {
+    int st, ed, i, ret;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * MQ_N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * MQ_N;
+
+    for (i = st; i < ed; i++) {
+        ret = mq_push(mq, i + 1, i + 1, id);
+        test_assert(ret == 0);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+static void do_mq_pop(long id) {
+    double interval;
+    ukey_t k;
+    uval_t val;
+
+    start_measure();
+
+    while(mq_pop(mq, &k, &val) == 0) {
+        test_assert(k == val);
+        pop_log[xadd2(&pop_seq, 1)] = k;
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+/* rank of a popped key = live keys smaller than it when it was popped */
+static void rank_error() {
+    unsigned long sum = 0, max = 0, rank;
+    int i, j, popped_below;
+
+    test_assert(pop_seq == MQ_N);
+
+    for (i = 0; i < MQ_N; i++) {
+        popped_below = 0;
+        for (j = pop_log[i] - 1; j > 0; j -= j & -j) {
+            popped_below += fenwick[j];
+        }
+        rank = pop_log[i] - 1 - popped_below;
+        sum += rank;
+        if (rank > max) {
+            max = rank;
+        }
+        for (j = pop_log[i]; j <= MQ_N; j += j & -j) {
+            fenwick[j]++;
+        }
+    }
+
+    printf("MQ RANK ERROR avg %.1lf max %lu\n", 1.0 * sum / MQ_N, max);
+}
+
+/* the largest key is a key like any other, its lane is not empty */
+static void mq_max_key() {
+    ukey_t k;
+    uval_t val;
+
+    test_assert(mq_top(mq, &k, &val) == -ENOENT);
+    test_assert(mq_push(mq, UINT64_MAX, 1, 0) == 0);
+    test_assert(mq_top(mq, &k, &val) == 0);
+    test_assert(k == UINT64_MAX && val == 1);
+    test_assert(mq_pop(mq, &k, &val) == 0);
+    test_assert(k == UINT64_MAX && val == 1);
+    test_assert(mq_pop(mq, &k, &val) == -ENOENT);
+}
+
+void* mq_fun(void* arg) {
+    long id = (long) arg;
+
+    do_mq_push(id);
+
+    do_barrier(id, "MQ PUSH");
+
+    do_mq_pop(id);
+
+    do_barrier(id, "MQ POP");
+
+    if (id == 0) {
+        rank_error();
+        mq_max_key();
+    }
+}
+
 void* push_fun(void* arg) {
     long id = (long) arg;
 
-    do_push(id, -1);
+    do_push(id, 0);
 
     do_barrier(id, "PUSH & POP");
+
+    do_push_batch(id);
+
+    do_barrier(id, "PUSH BATCH & POP BATCH");
 }
 
 void* pop_fun(void* arg) {
@@ -138,6 +375,22 @@ void* pop_fun(void* arg) {
     do_pop(id, -1);
 
     do_barrier(id, "PUSH & POP");
+
+    do_pop_batch(id);
+
+    do_barrier(id, "PUSH BATCH & POP BATCH");
+}
+
+void* dk_fun(void* arg) {
+    long id = (long) arg;
+
+    do_decrease_key(id);
+
+    do_barrier(id, "DECREASE KEY");
+
+    if (id == 0) {
+        check_decreased();
+    }
 }
 
 int main() {
@@ -158,7 +411,36 @@ int main() {
         pthread_join(tids[i], NULL);
     }
 
+    /* pushes never fail, whatever was not popped is still there */
+    test_assert(h->len == N - h_popped);
+
+    h_destroy(h);
+
+    pop_batch_locks();
+
+    h = h_create(POOL_SIZE);
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_create(&tids[i], NULL, dk_fun, (void*) i);
+    }
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
     h_destroy(h);
 
+    mq = mq_create(MQ_C * NUM_THREAD, MQ_N);
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_create(&tids[i], NULL, mq_fun, (void*) i);
+    }
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    mq_destroy(mq);
+
     return 0;
 }
\ No newline at end of file
@@ -19,9 +19,16 @@ typedef struct {
 #define cmpxchg2(addr,old,x)		__sync_bool_compare_and_swap(addr,old,x)
 #define xadd(addr,n)          		__sync_add_and_fetch(addr,n)
 #define xadd2(addr,n)				__sync_fetch_and_add(addr, n)
+/* a full barrier on x86, although gcc only promises acquire */
+#define xchg(addr,x)				__sync_lock_test_and_set(addr,x)
+/* double-width CAS on a 16 bytes aligned pair, needs -mcx16 */
+#define cmpxchg16(addr,old,x)		__sync_bool_compare_and_swap((unsigned __int128*) (addr),old,x)
 
 #define barrier()	 				__asm__ __volatile__("": : :"memory")
 
+/* spin-wait hint, keeps a waiting hyperthread off its sibling's resources */
+#define cpu_relax()					__asm__ __volatile__("pause\n": : :"memory")
+
 #define __X86_CASE_B	1
 #define __X86_CASE_W	2
 #define __X86_CASE_L	4
@@ -0,0 +1,80 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "atomic.h"
+#include "util.h"
+
+/*
+ * truncated exponential backoff on pause spins. every wait picks a random
+ * delay between half the limit and the limit, then doubles the limit up
+ * to a ceiling. the ceiling follows the contention: it grows when an
+ * operation went all the way up to it and decays while operations get
+ * through without waiting.
+ *
+ * a failed CAS or validation means another thread just got through at
+ * the same spot, retrying at once only adds traffic on that line.
+ *
+ * zeroed state is ready to use. keep one per thread, the jitter is seeded
+ * from its address.
+ */
+#define BACKOFF_MIN         4
+#define BACKOFF_CEIL_MIN    64
+#define BACKOFF_CEIL_MAX    (1U << 14)
+
+struct backoff {
+    unsigned int limit;
+    unsigned int ceil;
+    unsigned int seed;
+    unsigned int waits;
+};
+
+/* call after every failed attempt */
+static inline void backoff_wait(struct backoff* b) {
+    unsigned int n;
+
+    if (unlikely(!b->ceil)) {
+        b->ceil = BACKOFF_CEIL_MIN;
+        b->limit = BACKOFF_MIN;
+        b->seed = (unsigned int) (unsigned long) b | 1;
+    }
+
+    /* xorshift */
+    b->seed ^= b->seed << 13;
+    b->seed ^= b->seed >> 17;
+    b->seed ^= b->seed << 5;
+
+    for (n = b->limit / 2 + b->seed % (b->limit / 2 + 1); n; n--) {
+        cpu_relax();
+    }
+
+    b->waits++;
+    if (b->limit < b->ceil) {
+        b->limit <<= 1;
+    }
+}
+
+/* call once the operation is through */
+static inline void backoff_done(struct backoff* b) {
+    if (!b->waits) {
+        if (b->ceil > BACKOFF_CEIL_MIN) {
+            b->ceil -= b->ceil >> 4;
+        }
+        return;
+    }
+
+    if (b->limit >= b->ceil && b->ceil < BACKOFF_CEIL_MAX) {
+        b->ceil <<= 1;
+    }
+    b->limit = BACKOFF_MIN;
+    b->waits = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
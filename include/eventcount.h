@@ -0,0 +1,121 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <limits.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "atomic.h"
+
+/*
+ * eventcount, lets a thread sleep until a lock-free condition may have
+ * changed. a waiter does:
+ *
+ *     key = ec_prepare_wait(ec);
+ *     if (condition holds) {
+ *         ec_cancel_wait(ec);
+ *     } else {
+ *         ec_wait(ec, key);
+ *     }
+ *
+ * and loops. the other side makes the condition true, then ec_notify().
+ * notify only costs a fence and a load while nobody sleeps, just the load
+ * with ec_notify_after_rmw() when a locked instruction set the condition.
+ */
+struct eventcount {
+    unsigned int seq;
+    unsigned int waiters;
+    /* pause loops before parking, tuned by ec_spun() */
+    unsigned int spins;
+};
+
+#define EC_MIN_SPINS        16
+#define EC_MAX_SPINS        4096
+
+static inline void ec_init(struct eventcount* ec) {
+    ec->seq = 0;
+    ec->waiters = 0;
+    ec->spins = EC_MIN_SPINS * 8;
+}
+
+#ifdef __linux__
+static inline void ec_futex_wait(unsigned int* addr, unsigned int val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void ec_futex_wake(unsigned int* addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#else
+/* no futex, waiters just give their core away and check again */
+static inline void ec_futex_wait(unsigned int* addr, unsigned int val) {
+    if (ACCESS_ONCE(*addr) == val) {
+        sched_yield();
+    }
+}
+
+static inline void ec_futex_wake(unsigned int* addr) {
+}
+#endif
+
+static inline unsigned int ec_prepare_wait(struct eventcount* ec) {
+    xadd(&ec->waiters, 1);
+    /* the locked add orders it before the caller checks its condition */
+    return ACCESS_ONCE(ec->seq);
+}
+
+static inline void ec_cancel_wait(struct eventcount* ec) {
+    xadd(&ec->waiters, -1);
+}
+
+/* may return early, the caller checks its condition again anyway */
+static inline void ec_wait(struct eventcount* ec, unsigned int key) {
+    ec_futex_wait(&ec->seq, key);
+    xadd(&ec->waiters, -1);
+}
+
+/* for a caller that made the condition true with a locked rmw, which already orders it */
+static inline void ec_notify_after_rmw(struct eventcount* ec) {
+    if (ACCESS_ONCE(ec->waiters)) {
+        xadd(&ec->seq, 1);
+        /* wake everybody, a woken thread may lose the race and sleep again */
+        ec_futex_wake(&ec->seq);
+    }
+}
+
+static inline void ec_notify(struct eventcount* ec) {
+    /* the condition must be visible before waiters is read */
+    memory_mfence();
+    ec_notify_after_rmw(ec);
+}
+
+/* spin budget for this round, adapted to how often spinning pays off */
+static inline unsigned int ec_spin_budget(struct eventcount* ec) {
+    return ACCESS_ONCE(ec->spins);
+}
+
+static inline void ec_spun(struct eventcount* ec, int hit) {
+    unsigned int spins = ACCESS_ONCE(ec->spins);
+
+    /* racy on purpose, it is only a hint */
+    if (hit && spins < EC_MAX_SPINS) {
+        ACCESS_ONCE(ec->spins) = spins * 2;
+    } else if (!hit && spins > EC_MIN_SPINS) {
+        ACCESS_ONCE(ec->spins) = spins / 2;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef FLAT_COMBINING_H
+#define FLAT_COMBINING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sched.h>
+
+#include "util.h"
+#include "atomic.h"
+#include "taslock.h"
+
+/*
+ * flat combining. every thread publishes its request in its own record
+ * and whoever gets the lock serves all pending records against a
+ * sequential structure, while the others wait on their own cache line.
+ *
+ * the combine function gets the records up to the highest tid seen so
+ * far. it answers a request through fc_done(), a record with op FC_NONE
+ * has nothing pending.
+ */
+#define FC_NONE             0
+
+/* pause loops before a waiter gives its core away */
+#define FC_YIELD_LOOPS      1024
+
+struct fc_record {
+    int op;
+    int ret;
+    uval_t v;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+typedef void (*fc_combine_fun_t)(void* arg, struct fc_record* recs, int nr);
+
+struct fc {
+    tas_lock_t lock __attribute__((aligned(CACHELINE_SIZE)));
+    int nr_recs;
+    struct fc_record recs[MAX_NUM_THREADS];
+};
+
+static inline void fc_init(struct fc* fc) {
+    int i;
+
+    tas_lock_init(&fc->lock);
+    fc->nr_recs = 0;
+    for (i = 0; i < MAX_NUM_THREADS; i++) {
+        fc->recs[i].op = FC_NONE;
+    }
+}
+
+/* called by the combiner, the owner may return as soon as op is cleared */
+static inline void fc_done(struct fc_record* rec, int ret) {
+    rec->ret = ret;
+    barrier();
+    ACCESS_ONCE(rec->op) = FC_NONE;
+}
+
+/* v goes in with the request and comes back with the answer */
+static inline int fc_request(struct fc* fc, int tid, int op, uval_t* v, fc_combine_fun_t combine, void* arg) {
+    struct fc_record* rec = &fc->recs[tid];
+    unsigned int spins = 0;
+    int nr;
+
+    while((nr = ACCESS_ONCE(fc->nr_recs)) <= tid) {
+        cmpxchg(&fc->nr_recs, nr, tid + 1);
+    }
+
+    rec->v = *v;
+    barrier();
+    ACCESS_ONCE(rec->op) = op;
+
+    while(ACCESS_ONCE(rec->op) != FC_NONE) {
+        if (tas_trylock(&fc->lock)) {
+            /* ours is pending, so this pass serves it too */
+            combine(arg, fc->recs, ACCESS_ONCE(fc->nr_recs));
+            tas_unlock(&fc->lock);
+            break;
+        }
+        cpu_relax();
+        if (++spins == FC_YIELD_LOOPS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+
+    barrier();
+    *v = rec->v;
+    return rec->ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
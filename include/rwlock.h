@@ -5,6 +5,7 @@
 extern "C" {
 #endif
 
+#include "atomic.h"
 #include "spinlock.h"
 
 /*
@@ -54,10 +55,6 @@ static void __write_unlock(rwlock_t* lock);
 #define unlikely(x)				__builtin_expect(!!(x), 0)
 #endif
 
-#ifndef cpu_relax
-#define cpu_relax() asm volatile("pause\n" : : : "memory")
-#endif
-
 /**
  * rspin_until_writer_unlock - inc reader count & spin until writer is gone
  * @lock  : Pointer to queue rwlock structure
@@ -0,0 +1,188 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "taslock.h"
+#include "util.h"
+
+/*
+ * Fixed-size object allocator.
+ *
+ * Objects are carved out of big chunks without any per-object header,
+ * every thread bumps in its own chunk and keeps its own free list.
+ * Chunks are aligned to their size, so an object finds its slab by
+ * masking its address, slab_free() doesn't need to be told the slab.
+ *
+ * Frees go to the freeing thread's list. Once it holds two batches, one
+ * batch moves to a shared stack of batches, which is where a thread
+ * refills from when it runs dry. The lock is taken once per batch.
+ */
+
+#define SLAB_CHUNK_SIZE     (1UL << 16)
+#define SLAB_BATCH          128
+
+struct slab;
+
+struct slab_chunk {
+    struct slab* slab;
+    struct slab_chunk* next;
+};
+
+struct slab_cache {
+    char *cur, *end;
+    void* free_list;
+    unsigned int nr_free;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+struct slab {
+    unsigned int obj_size;
+    tas_lock_t lock;
+    /* full batches, linked through their first objects */
+    void* batches;
+    /* objects freed without a thread, a batch in the making */
+    void* free_list;
+    unsigned int nr_free;
+    struct slab_chunk* chunks;
+    unsigned long nr_chunks;
+    struct slab_cache caches[MAX_NUM_THREADS];
+};
+
+#define SLAB_NEXT(obj)      (*(void**) (obj))
+#define SLAB_BATCH_NEXT(obj)    (((void**) (obj))[1])
+
+static inline struct slab* slab_create(unsigned int obj_size) {
+    struct slab* slab = (struct slab*) aligned_alloc(CACHELINE_SIZE, sizeof(struct slab));
+
+    memset(slab, 0, sizeof(struct slab));
+
+    /* keep the lower bits of every object clear for tags */
+    slab->obj_size = (obj_size + 7) & ~7U;
+    /* a free object holds both links */
+    if (slab->obj_size < 2 * sizeof(void*)) {
+        slab->obj_size = 2 * sizeof(void*);
+    }
+    tas_lock_init(&slab->lock);
+
+    return slab;
+}
+
+static inline void slab_destroy(struct slab* slab) {
+    struct slab_chunk *chunk, *next;
+
+    for (chunk = slab->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    free(slab);
+}
+
+static inline void* slab_alloc(struct slab* slab, int tid) {
+    struct slab_cache* cache = &slab->caches[tid];
+    struct slab_chunk* chunk;
+    void* obj;
+
+    if (!cache->free_list) {
+        if (cache->cur + slab->obj_size <= cache->end) {
+            obj = cache->cur;
+            cache->cur += slab->obj_size;
+            return obj;
+        }
+
+        tas_lock(&slab->lock);
+        if (slab->batches) {
+            cache->free_list = slab->batches;
+            cache->nr_free = SLAB_BATCH;
+            slab->batches = SLAB_BATCH_NEXT(cache->free_list);
+        } else {
+            cache->free_list = slab->free_list;
+            cache->nr_free = slab->nr_free;
+            slab->free_list = NULL;
+            slab->nr_free = 0;
+        }
+        if (!cache->free_list) {
+            chunk = (struct slab_chunk*) aligned_alloc(SLAB_CHUNK_SIZE, SLAB_CHUNK_SIZE);
+            chunk->slab = slab;
+            chunk->next = slab->chunks;
+            slab->chunks = chunk;
+            slab->nr_chunks++;
+            tas_unlock(&slab->lock);
+
+            obj = (char*) (chunk + 1);
+            cache->cur = (char*) obj + slab->obj_size;
+            cache->end = (char*) chunk + SLAB_CHUNK_SIZE;
+            return obj;
+        }
+        tas_unlock(&slab->lock);
+    }
+
+    obj = cache->free_list;
+    cache->free_list = SLAB_NEXT(obj);
+    cache->nr_free--;
+
+    return obj;
+}
+
+static inline struct slab* slab_of(void* obj) {
+    return ((struct slab_chunk*) ((unsigned long) obj & ~(SLAB_CHUNK_SIZE - 1)))->slab;
+}
+
+/* tid < 0 is for callers that free on no thread's behalf, e.g. a reclaimer */
+static inline void slab_free(void* obj, int tid) {
+    struct slab* slab = slab_of(obj);
+    struct slab_cache* cache;
+    void *last, *batch;
+    int i;
+
+    if (tid < 0) {
+        tas_lock(&slab->lock);
+        SLAB_NEXT(obj) = slab->free_list;
+        slab->free_list = obj;
+        if (++slab->nr_free == SLAB_BATCH) {
+            SLAB_BATCH_NEXT(obj) = slab->batches;
+            slab->batches = obj;
+            slab->free_list = NULL;
+            slab->nr_free = 0;
+        }
+        tas_unlock(&slab->lock);
+        return;
+    }
+
+    cache = &slab->caches[tid];
+    SLAB_NEXT(obj) = cache->free_list;
+    cache->free_list = obj;
+    if (++cache->nr_free < 2 * SLAB_BATCH) {
+        return;
+    }
+
+    /* keep the recently freed half, it is the one still in cache */
+    last = obj;
+    for (i = 1; i < SLAB_BATCH; i++) {
+        last = SLAB_NEXT(last);
+    }
+    batch = SLAB_NEXT(last);
+    SLAB_NEXT(last) = NULL;
+    cache->nr_free = SLAB_BATCH;
+
+    tas_lock(&slab->lock);
+    SLAB_BATCH_NEXT(batch) = slab->batches;
+    slab->batches = batch;
+    tas_unlock(&slab->lock);
+}
+
+/* bytes taken from the system, including what is free or not carved yet */
+static inline unsigned long slab_mem_usage(struct slab* slab) {
+    return ACCESS_ONCE(slab->nr_chunks) * SLAB_CHUNK_SIZE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,6 +41,24 @@ static inline void spin_unlock(spinlock_t *lock) {
     __asm__ __volatile__("lock; incb %0;" : "+m" (lock->slock) :: "memory", "cc");
 }
 
+/* take a ticket only if it would be served right away */
+static inline int spin_trylock(spinlock_t *lock) {
+    unsigned int slock = ACCESS_ONCE(lock->slock);
+
+    if (((slock >> 8) & 0xff) != (slock & 0xff)) {
+        return 0;
+    }
+
+    return cmpxchg2(&lock->slock, slock, (slock & ~0xffffU) | ((slock + 0x100) & 0xffff));
+}
+
+/* the owner byte lags the next ticket byte while the lock is held */
+static inline int spin_is_locked(spinlock_t *lock) {
+    unsigned int slock = ACCESS_ONCE(lock->slock);
+
+    return ((slock >> 8) & 0xff) != (slock & 0xff);
+}
+
 #ifdef __cplusplus
 }
 #endif
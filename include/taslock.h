@@ -0,0 +1,59 @@
+#ifndef TASLOCK_H
+#define TASLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sched.h>
+
+#include "atomic.h"
+#include "backoff.h"
+
+/*
+ * test-and-test-and-set lock. unlike the ticket spinlock it hands the lock
+ * to whoever is running, so a waiter that got preempted holds nobody up.
+ * use it where threads may outnumber cores and critical sections chain.
+ */
+typedef struct {
+    unsigned int slock;
+} tas_lock_t;
+
+/* backoff rounds before a waiter gives its core away */
+#define TAS_YIELD_WAITS     16
+
+/* one per thread, so the ceiling follows how contended the locks are */
+static __thread struct backoff tas_backoff;
+
+static inline void tas_lock_init(tas_lock_t *lock) {
+    lock->slock = 0;
+}
+
+static inline int tas_trylock(tas_lock_t *lock) {
+    return !ACCESS_ONCE(lock->slock) && cmpxchg2(&lock->slock, 0, 1);
+}
+
+static inline void tas_lock(tas_lock_t *lock) {
+    while(!tas_trylock(lock)) {
+        backoff_wait(&tas_backoff);
+        if (tas_backoff.waits % TAS_YIELD_WAITS == 0) {
+            sched_yield();
+        }
+    }
+    backoff_done(&tas_backoff);
+}
+
+static inline void tas_unlock(tas_lock_t *lock) {
+    barrier();
+    ACCESS_ONCE(lock->slock) = 0;
+}
+
+static inline int tas_is_locked(tas_lock_t *lock) {
+    return ACCESS_ONCE(lock->slock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
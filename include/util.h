@@ -12,6 +12,9 @@ typedef struct {
     uval_t v;
 }entry_t;
 
+/* visitor of a range scan, return non-zero to stop scanning */
+typedef int (*scan_fun_t)(ukey_t k, uval_t v, void* arg);
+
 static int k_cmp(ukey_t a, ukey_t b) {
     if (a > b) return 1;
     if (a < b) return -1;
@@ -21,7 +24,12 @@ static int k_cmp(ukey_t a, ukey_t b) {
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
-#define MAX_NUM_THREADS     32
+/* start loading the line of x, for the next hop of a traversal */
+#define prefetch_r(x)   __builtin_prefetch((const void*) (x), 0, 3)
+
+#define CACHELINE_SIZE      64
+
+#define MAX_NUM_THREADS     64
 #define MAX_N               10000000
 
 #endif
\ No newline at end of file
@@ -7,6 +7,9 @@
 #include <errno.h>
 
 #include "linked_list.h"
+#include "backoff.h"
+
+static __thread struct backoff ll_backoff;
 
 static struct ll_node* malloc_node(ukey_t k, uval_t v) {
     struct ll_node* node = (struct ll_node*) malloc(sizeof(struct ll_node));
@@ -68,6 +71,7 @@ retry:
     while(k_cmp(curr->e.k, k) < 0) {
         pred = curr;
         curr = GET_NODE(pred->next);
+        prefetch_r(GET_NODE(curr->next));
     }
 
     spin_lock(&pred->lock);
@@ -78,6 +82,7 @@ retry:
             spin_unlock(&pred->lock);
             spin_unlock(&curr->lock);
             ebr_exit(ll->ebr, tid);
+            backoff_done(&ll_backoff);
             return -EEXIST;
         } else {
             node = malloc_node(k, v);
@@ -87,11 +92,13 @@ retry:
             spin_unlock(&pred->lock);
             spin_unlock(&curr->lock);
             ebr_exit(ll->ebr, tid);
+            backoff_done(&ll_backoff);
             return 0;
         }
     } else {
         spin_unlock(&pred->lock);
         spin_unlock(&curr->lock);
+        backoff_wait(&ll_backoff);
         goto retry;
     }
 }
@@ -107,6 +114,7 @@ retry:
     while(k_cmp(curr->e.k, k) < 0) {
         pred = curr;
         curr = GET_NODE(pred->next);
+        prefetch_r(GET_NODE(curr->next));
     }
 
     if (k_cmp(curr->e.k, k) == 0 && !IS_MARKED(curr->next)) {
@@ -131,6 +139,7 @@ retry:
     while(k_cmp(curr->e.k, k) < 0) {
         pred = curr;
         curr = GET_NODE(pred->next);
+        prefetch_r(GET_NODE(curr->next));
     }
 
     spin_lock(&pred->lock);
@@ -145,16 +154,19 @@ retry:
             spin_unlock(&pred->lock);
             spin_unlock(&curr->lock);
             ebr_exit(ll->ebr, tid);
+            backoff_done(&ll_backoff);
             return 0;
         } else {
             spin_unlock(&pred->lock);
             spin_unlock(&curr->lock);
             ebr_exit(ll->ebr, tid);
+            backoff_done(&ll_backoff);
             return -ENOENT;
         }
     } else {
         spin_unlock(&pred->lock);
         spin_unlock(&curr->lock);
+        backoff_wait(&ll_backoff);
         goto retry;
     }
 }
@@ -179,6 +191,68 @@ int ll_range(struct ll* ll, ukey_t k, unsigned int len, uval_t* v_arr, int tid)
     return cnt;
 }
 
+void ll_cursor_open(struct ll* ll, struct ll_cursor* cur, ukey_t k, int tid) {
+    struct ll_node *curr;
+
+    cur->ll = ll;
+    cur->tid = tid;
+
+    ebr_enter(ll->ebr, tid);
+
+    curr = GET_NODE(ll->head->next);
+    while(k_cmp(curr->e.k, k) < 0) {
+        curr = GET_NODE(curr->next);
+    }
+    cur->node = curr;
+}
+
+/* copy at most len entries under the cursor and move forward, 0 at the end */
+int ll_cursor_next(struct ll_cursor* cur, entry_t* e_arr, unsigned int len) {
+    struct ll_node *curr = cur->node;
+    unsigned int cnt = 0;
+
+    while(cnt < len && curr != cur->ll->tail) {
+        if (!IS_MARKED(curr->next)) {
+            e_arr[cnt++] = curr->e;
+        }
+        curr = GET_NODE(curr->next);
+    }
+    cur->node = curr;
+
+    return cnt;
+}
+
+void ll_cursor_close(struct ll_cursor* cur) {
+    ebr_exit(cur->ll->ebr, cur->tid);
+}
+
+/* call fun on every entry >= k in place until it returns non-zero */
+int ll_scan(struct ll* ll, ukey_t k, scan_fun_t fun, void* arg, int tid) {
+    struct ll_node *curr;
+    int cnt = 0;
+
+    ebr_enter(ll->ebr, tid);
+
+    curr = GET_NODE(ll->head->next);
+    while(k_cmp(curr->e.k, k) < 0) {
+        curr = GET_NODE(curr->next);
+    }
+
+    while(curr != ll->tail) {
+        if (!IS_MARKED(curr->next)) {
+            cnt++;
+            if (fun(curr->e.k, curr->e.v, arg)) {
+                break;
+            }
+        }
+        curr = GET_NODE(curr->next);
+    }
+
+    ebr_exit(ll->ebr, tid);
+
+    return cnt;
+}
+
 void ll_print(struct ll* ll) {
     struct ll_node *curr;
     
@@ -21,6 +21,13 @@ struct ll {
     struct ebr* ebr;
 };
 
+/* a cursor pins the list with an EBR guard until it is closed */
+struct ll_cursor {
+    struct ll* ll;
+    struct ll_node* node;
+    int tid;
+};
+
 #define IS_MARKED(v)        ((v) & 0x1)
 #define MARK_NODE(v)        ((v) | 0x1)
 #define REMOVE_MARK(v)      ((v) & ~0x1)
@@ -32,6 +39,10 @@ extern int ll_insert(struct ll* ll, ukey_t k, uval_t v, int tid);
 extern int ll_lookup(struct ll* ll, ukey_t k, uval_t* v, int tid);
 extern int ll_remove(struct ll* ll, ukey_t k, int tid);
 extern int ll_range(struct ll* ll, ukey_t k, unsigned int len, uval_t* v_arr, int tid);
+extern void ll_cursor_open(struct ll* ll, struct ll_cursor* cur, ukey_t k, int tid);
+extern int ll_cursor_next(struct ll_cursor* cur, entry_t* e_arr, unsigned int len);
+extern void ll_cursor_close(struct ll_cursor* cur);
+extern int ll_scan(struct ll* ll, ukey_t k, scan_fun_t fun, void* arg, int tid);
 extern void ll_print(struct ll* ll);
 
 #ifdef LL_DEBUG
@@ -7,6 +7,9 @@
 #include <errno.h>
 
 #include "linked_list.h"
+#include "backoff.h"
+
+static __thread struct backoff ll_backoff;
 
 static struct ll_node* malloc_node(ukey_t k, uval_t v) {
     struct ll_node* node = (struct ll_node*) malloc(sizeof(struct ll_node));
@@ -63,6 +66,7 @@ retry:
         curr_markable_v = __curr->next;
         while(IS_MARKED(curr_markable_v)) {
             if (!cmpxchg2(&__pred->next, __curr, REMOVE_MARK(curr_markable_v))) {
+                backoff_wait(&ll_backoff);
                 goto retry;
             }
             ebr_put(ll->ebr, __curr, tid);
@@ -77,6 +81,7 @@ retry:
         }
         __pred = __curr;
         __curr = GET_NODE(curr_markable_v);
+        prefetch_r(GET_NODE(__curr->next));
     }
 }
 
@@ -89,6 +94,7 @@ retry:
 
     if (k_cmp(curr->e.k, k) == 0) {
         ebr_exit(ll->ebr, tid);
+        backoff_done(&ll_backoff);
         return -EEXIST;
     } else {
         node = malloc_node(k, v);
@@ -96,9 +102,11 @@ retry:
         
         if (!cmpxchg2(&pred->next, curr, node)) {
             free_node(node);
+            backoff_wait(&ll_backoff);
             goto retry;
         }
         ebr_exit(ll->ebr, tid);
+        backoff_done(&ll_backoff);
         return 0;
     }
 }
@@ -109,6 +117,7 @@ int ll_lookup(struct ll* ll, ukey_t k, uval_t* v, int tid) {
     ebr_enter(ll->ebr, tid);
     while(k_cmp(curr->e.k, k) < 0) {
         curr = GET_NODE(curr->next);
+        prefetch_r(GET_NODE(curr->next));
     }
 
     if (k_cmp(curr->e.k, k) == 0 && !IS_MARKED(curr->next)) {
@@ -133,15 +142,18 @@ retry:
     if (k_cmp(curr->e.k, k) == 0) {
         curr_markable_v = curr->next;
         if (!cmpxchg2(&curr->next, REMOVE_MARK(curr_markable_v), MARK_NODE(curr_markable_v))) {
+            backoff_wait(&ll_backoff);
             goto retry;
         }
         if (cmpxchg2(&pred->next, curr, REMOVE_MARK(curr_markable_v))) {
             ebr_put(ll->ebr, curr, tid);
         }
         ebr_exit(ll->ebr, tid);
+        backoff_done(&ll_backoff);
         return 0;
     } else {
         ebr_exit(ll->ebr, tid);
+        backoff_done(&ll_backoff);
         return -ENOENT;
     }
 }
@@ -169,6 +181,68 @@ int ll_range(struct ll* ll, ukey_t k, unsigned int len, uval_t* v_arr, int tid)
     return cnt;
 }
 
+void ll_cursor_open(struct ll* ll, struct ll_cursor* cur, ukey_t k, int tid) {
+    struct ll_node *curr;
+
+    cur->ll = ll;
+    cur->tid = tid;
+
+    ebr_enter(ll->ebr, tid);
+
+    curr = GET_NODE(ll->head->next);
+    while(k_cmp(curr->e.k, k) < 0) {
+        curr = GET_NODE(curr->next);
+    }
+    cur->node = curr;
+}
+
+/* copy at most len entries under the cursor and move forward, 0 at the end */
+int ll_cursor_next(struct ll_cursor* cur, entry_t* e_arr, unsigned int len) {
+    struct ll_node *curr = cur->node;
+    unsigned int cnt = 0;
+
+    while(cnt < len && curr != cur->ll->tail) {
+        if (!IS_MARKED(curr->next)) {
+            e_arr[cnt++] = curr->e;
+        }
+        curr = GET_NODE(curr->next);
+    }
+    cur->node = curr;
+
+    return cnt;
+}
+
+void ll_cursor_close(struct ll_cursor* cur) {
+    ebr_exit(cur->ll->ebr, cur->tid);
+}
+
+/* call fun on every entry >= k in place until it returns non-zero */
+int ll_scan(struct ll* ll, ukey_t k, scan_fun_t fun, void* arg, int tid) {
+    struct ll_node *curr;
+    int cnt = 0;
+
+    ebr_enter(ll->ebr, tid);
+
+    curr = GET_NODE(ll->head->next);
+    while(k_cmp(curr->e.k, k) < 0) {
+        curr = GET_NODE(curr->next);
+    }
+
+    while(curr != ll->tail) {
+        if (!IS_MARKED(curr->next)) {
+            cnt++;
+            if (fun(curr->e.k, curr->e.v, arg)) {
+                break;
+            }
+        }
+        curr = GET_NODE(curr->next);
+    }
+
+    ebr_exit(ll->ebr, tid);
+
+    return cnt;
+}
+
 void ll_print(struct ll* ll) {
     struct ll_node *curr;
     
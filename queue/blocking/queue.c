@@ -1,54 +1,119 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "atomic.h"
 #include "queue.h"
 
 struct queue* q_create(unsigned int size) {
-    struct queue* q = (struct queue*) malloc(sizeof(struct queue));
+    struct queue* q = (struct queue*) aligned_alloc(CACHELINE_SIZE, sizeof(struct queue));
     
     q->buffer = (uval_t*) malloc(size * sizeof(uval_t));
     q->cap = size;
     q->used = 0;
+    q->head = 0;
+    q->tail = 0;
+    pthread_mutex_init(&q->head_lock, NULL);
+    pthread_mutex_init(&q->tail_lock, NULL);
+    ec_init(&q->not_empty);
+    ec_init(&q->not_full);
 
     return q;
 }
 
 void q_destroy(struct queue* q){
+    pthread_mutex_destroy(&q->head_lock);
+    pthread_mutex_destroy(&q->tail_lock);
     free(q->buffer);
     free(q);
 }
 
-static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+/*
+ * wait until used is no longer busy. the other end usually catches up
+ * soon, so spin a while before parking on ec.
+ */
+static void q_wait(unsigned int* used, unsigned int busy, struct eventcount* ec) {
+    unsigned int key, budget = ec_spin_budget(ec), i;
+
+    for (i = 0; i < budget; i++) {
+        if (ACCESS_ONCE(*used) != busy) {
+            if (i) {
+                ec_spun(ec, 1);
+            }
+            return;
+        }
+        cpu_relax();
+    }
+    ec_spun(ec, 0);
+
+    while(1) {
+        key = ec_prepare_wait(ec);
+        if (ACCESS_ONCE(*used) != busy) {
+            ec_cancel_wait(ec);
+            return;
+        }
+        ec_wait(ec, key);
+    }
+}
 
 void q_push(struct queue* q, uval_t v){
-    pthread_mutex_lock(&lock);
-    while(!(q->used < q->cap)) {
-        pthread_cond_wait(&cond, &lock);
+    unsigned int c;
+
+    while(1) {
+        q_wait(&q->used, q->cap, &q->not_full);
+
+        pthread_mutex_lock(&q->tail_lock);
+        /* another pusher may have taken the slot meanwhile */
+        if (ACCESS_ONCE(q->used) != q->cap) {
+            break;
+        }
+        pthread_mutex_unlock(&q->tail_lock);
+    }
+    q->buffer[q->tail] = v;
+    q->tail = (q->tail + 1 == q->cap) ? 0 : q->tail + 1;
+    /* the locked add also publishes the item to the poppers */
+    c = xadd2(&q->used, 1);
+    pthread_mutex_unlock(&q->tail_lock);
+
+    /* poppers only park on an empty ring */
+    if (c == 0) {
+        ec_notify_after_rmw(&q->not_empty);
     }
-    q->buffer[q->used++] = v;
-    pthread_cond_signal(&cond);
-    pthread_mutex_unlock(&lock);
 }
 
 void q_pop(struct queue* q, uval_t* v){
-    pthread_mutex_lock(&lock);
-    while(!(q->used != 0)) {
-        pthread_cond_wait(&cond, &lock);
+    unsigned int c;
+
+    while(1) {
+        q_wait(&q->used, 0, &q->not_empty);
+
+        pthread_mutex_lock(&q->head_lock);
+        if (ACCESS_ONCE(q->used) != 0) {
+            break;
+        }
+        pthread_mutex_unlock(&q->head_lock);
+    }
+    *v = q->buffer[q->head];
+    q->head = (q->head + 1 == q->cap) ? 0 : q->head + 1;
+    c = xadd2(&q->used, -1);
+    pthread_mutex_unlock(&q->head_lock);
+
+    if (c == q->cap) {
+        ec_notify_after_rmw(&q->not_full);
     }
-    *v = q->buffer[--(q->used)];
-    pthread_cond_signal(&cond);
-    pthread_mutex_unlock(&lock);
 }
 
 int q_front(struct queue* q, uval_t* v){
-    if (q->used) {
-        *v = q->buffer[q->cap];
-        return 1;
+    int ret = -ENOENT;
+
+    pthread_mutex_lock(&q->head_lock);
+    if (ACCESS_ONCE(q->used)) {
+        *v = q->buffer[q->head];
+        ret = 0;
     }
+    pthread_mutex_unlock(&q->head_lock);
 
-    return 0;
+    return ret;
 }
@@ -7,11 +7,28 @@
 
 #include "atomic.h"
 #include "util.h"
+#include "eventcount.h"
 
+/*
+ * bounded FIFO ring with one lock per end, pushers and poppers only meet
+ * on used. a full or empty ring parks the thread on an eventcount, outside
+ * of the locks.
+ */
 struct queue {
     uval_t* buffer;
     unsigned int cap;
+    /* items in the ring, changed by both ends with xadd */
     unsigned int used;
+
+    /* poppers */
+    pthread_mutex_t head_lock __attribute__((aligned(CACHELINE_SIZE)));
+    struct eventcount not_empty;
+    unsigned int head;
+
+    /* pushers */
+    pthread_mutex_t tail_lock __attribute__((aligned(CACHELINE_SIZE)));
+    struct eventcount not_full;
+    unsigned int tail;
 };
 
 extern struct queue* q_create(unsigned int size);
@@ -20,4 +37,4 @@ extern void q_push(struct queue* q, uval_t v);
 extern void q_pop(struct queue* q, uval_t* v);
 extern int q_front(struct queue* q, uval_t* v);
 
-#endif
\ No newline at end of file
+#endif
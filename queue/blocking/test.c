@@ -45,6 +45,8 @@ uval_t v[N];
 
 struct queue* q;
 
+uval_t pushed, popped;
+
 static void gen_data() {
     int i;
 
@@ -90,6 +92,7 @@ static void do_barrier(long id, const char* arg) {
 static void do_push(long id, int expect_ret) {
     int st, ed, i, ret;
     double interval;
+    uval_t sum = 0;
 
     start_measure();
 
@@ -98,8 +101,10 @@ static void do_push(long id, int expect_ret) {
 
     for (i = st; i < ed; i++) {
         q_push(q, v[i]);
+        sum += v[i];
         test_assert(expect_ret == -1 || ret == expect_ret);
     }
+    xadd(&pushed, sum);
 
     interval = end_measure();
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
@@ -108,7 +113,7 @@ static void do_push(long id, int expect_ret) {
 static void do_pop(long id, int expect_ret) {
     int st, ed, i, ret;
     double interval;
-    uval_t v;
+    uval_t v, sum = 0;
 
     start_measure();
 
@@ -117,8 +122,10 @@ static void do_pop(long id, int expect_ret) {
 
     for (i = st; i < ed; i++) {
         q_pop(q, &v);
+        sum += v;
         test_assert(expect_ret == -1 || ret == expect_ret);
     }
+    xadd(&popped, sum);
 
     interval = end_measure();
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
@@ -140,6 +147,28 @@ void* pop_fun(void* arg) {
     do_barrier(id, "PUSH & POP");
 }
 
+/* single thread, head and tail wrap around a few times */
+static void check_fifo() {
+    uval_t v, next_push = 1, next_pop = 1;
+    int i;
+
+    /* start half full, so head and tail do not wrap together */
+    for (i = 0; i < POOL_SIZE / 2; i++) {
+        q_push(q, next_push++);
+    }
+    for (i = 0; i < 3 * POOL_SIZE; i++) {
+        q_push(q, next_push++);
+        test_assert(q_front(q, &v) == 0 && v == next_pop);
+        q_pop(q, &v);
+        test_assert(v == next_pop++);
+    }
+    while(next_pop < next_push) {
+        q_pop(q, &v);
+        test_assert(v == next_pop++);
+    }
+    test_assert(q_front(q, &v) == -ENOENT);
+}
+
 int main() {
     long i;
 
@@ -158,6 +187,11 @@ int main() {
         pthread_join(tids[i], NULL);
     }
 
+    test_assert(pushed == popped);
+    test_assert(q_front(q, &v[0]) == -ENOENT);
+
+    check_fifo();
+
     q_destroy(q);
 
     return 0;
@@ -0,0 +1,459 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sched.h>
+
+#include "queue.h"
+#include "atomic.h"
+
+#define Q_PAIR(v, state)    (((unsigned __int128) (state) << 64) | (uval_t) (v))
+
+#ifdef Q_PREEMPT
+/* test builds: a push gets overtaken between its xadd and its cell */
+#define q_preempt()         sched_yield()
+#else
+#define q_preempt()
+#endif
+
+static struct q_seg* alloc_seg(long id) {
+    struct q_seg* seg = (struct q_seg*) aligned_alloc(CACHELINE_SIZE, sizeof(struct q_seg));
+
+    /* every cell starts out Q_CELL_EMPTY with no request */
+    memset(seg, 0, sizeof(struct q_seg));
+    seg->id = id;
+
+    return seg;
+}
+
+static void free_seg(struct q_seg* seg) {
+    free(seg);
+}
+
+/* cell pos, NULL if it lies behind *sp. missing segments are appended */
+static struct q_cell* find_cell(struct q_seg** sp, long pos) {
+    struct q_seg *seg = *sp, *next;
+    long id = pos / Q_SEG_SIZE;
+
+    if (id < seg->id) {
+        return NULL;
+    }
+    while(seg->id < id) {
+        next = ACCESS_ONCE(seg->next);
+        if (!next) {
+            next = alloc_seg(seg->id + 1);
+            if (!cmpxchg2(&seg->next, NULL, next)) {
+                /* nobody has seen it */
+                free_seg(next);
+                next = ACCESS_ONCE(seg->next);
+            }
+        }
+        seg = next;
+    }
+    *sp = seg;
+
+    return &seg->cells[pos % Q_SEG_SIZE];
+}
+
+/* positions only grow, helpers move them past the cells they used */
+static void advance_pos(long* pos, long i) {
+    long p = ACCESS_ONCE(*pos);
+
+    while(p <= i && !cmpxchg2(pos, p, i + 1)) {
+        p = ACCESS_ONCE(*pos);
+    }
+}
+
+/* the same for head and tail, 1 if we moved it */
+static int advance_seg(struct q_seg** sp, struct q_seg* seg) {
+    struct q_seg* s = ACCESS_ONCE(*sp);
+
+    while(s->id < seg->id) {
+        if (cmpxchg2(sp, s, seg)) {
+            return 1;
+        }
+        s = ACCESS_ONCE(*sp);
+    }
+    return 0;
+}
+
+static void q_seen(struct queue* q, int tid) {
+    int nr;
+
+    while((nr = ACCESS_ONCE(q->nr_threads)) <= tid) {
+        cmpxchg(&q->nr_threads, nr, tid + 1);
+    }
+}
+
+/*
+ * retire what lies behind the head. a pop request published meanwhile
+ * may still walk those cells, then the base goes back until next time.
+ */
+static void clean(struct queue* q, int tid) {
+    struct q_seg *old, *head, *seg, *next;
+
+    if (ACCESS_ONCE(q->nr_deq_reqs) || !tas_trylock(&q->clean_lock)) {
+        return;
+    }
+
+    old = q->base;
+    head = ACCESS_ONCE(q->head);
+    if (old != head) {
+        /* tail must not be left on a retired segment */
+        advance_seg(&q->tail, head);
+        ACCESS_ONCE(q->base) = head;
+        memory_mfence();
+        if (ACCESS_ONCE(q->nr_deq_reqs)) {
+            ACCESS_ONCE(q->base) = old;
+        } else {
+            for (seg = old; seg != head; seg = next) {
+                next = seg->next;
+                ebr_put(q->ebr, seg, tid);
+            }
+        }
+    }
+
+    tas_unlock(&q->clean_lock);
+}
+
+struct queue* q_create() {
+    struct queue* q = (struct queue*) aligned_alloc(CACHELINE_SIZE, sizeof(struct queue));
+    struct q_seg* seg = alloc_seg(0);
+
+    memset(q, 0, sizeof(struct queue));
+
+    /* ids of requests are positions and must be positive, skip cell 0 */
+    q->enq_pos = 1;
+    q->deq_pos = 1;
+    q->head = seg;
+    q->tail = seg;
+    q->base = seg;
+    tas_lock_init(&q->clean_lock);
+
+    q->ebr = ebr_create((free_fun_t) free_seg);
+
+    return q;
+}
+
+void q_destroy(struct queue* q) {
+    struct q_seg *seg, *next;
+
+    for (seg = q->base; seg; seg = next) {
+        next = seg->next;
+        free_seg(seg);
+    }
+
+    ebr_destroy(q->ebr);
+
+    free(q);
+}
+
+/*
+ * what cell i holds for its popper: 0 a value, -ENOENT the queue was
+ * empty at i, -EAGAIN nothing will ever land here. a cell given up on
+ * goes to a pending push of one of our peers, taken in turn.
+ */
+static int help_enq(struct queue* q, int tid, struct q_cell* c, long i) {
+    struct q_thread* th = &q->threads[tid];
+    struct q_enq_req *e, *pe;
+    long id, ei;
+    uval_t ev;
+    int spins;
+
+    for (spins = 0; spins < Q_SPIN && ACCESS_ONCE(c->state) == Q_CELL_EMPTY; spins++) {
+        cpu_relax();
+    }
+    /* the push that owns the cell is too late now */
+    cmpxchg16(c, Q_PAIR(0, Q_CELL_EMPTY), Q_PAIR(0, Q_CELL_TOP));
+    if (ACCESS_ONCE(c->state) == Q_CELL_FULL) {
+        return 0;
+    }
+
+    e = ACCESS_ONCE(c->enq);
+    if (!e) {
+        pe = &q->enq_reqs[th->enq_peer];
+        id = ACCESS_ONCE(pe->id);
+        /* the peer we stayed with got its push through */
+        if (th->enq_id && th->enq_id != id) {
+            th->enq_id = 0;
+            th->enq_peer = (th->enq_peer + 1) % ACCESS_ONCE(q->nr_threads);
+            pe = &q->enq_reqs[th->enq_peer];
+            id = ACCESS_ONCE(pe->id);
+        }
+        if (id > 0 && id <= i && !cmpxchg2(&c->enq, NULL, pe) && ACCESS_ONCE(c->enq) != pe) {
+            /* another request took the cell, stay with this peer */
+            th->enq_id = id;
+        } else {
+            th->enq_id = 0;
+            th->enq_peer = (th->enq_peer + 1) % ACCESS_ONCE(q->nr_threads);
+        }
+        cmpxchg2(&c->enq, NULL, Q_REQ_TOP);
+        e = ACCESS_ONCE(c->enq);
+    }
+
+    if (e == Q_REQ_TOP) {
+        return ACCESS_ONCE(q->enq_pos) <= i ? -ENOENT : -EAGAIN;
+    }
+
+    /* v is written before id and not touched again while id is ours */
+    ei = ACCESS_ONCE(e->id);
+    barrier();
+    ev = ACCESS_ONCE(e->v);
+    if (ei > i) {
+        /* a later request of the same thread */
+        if (ACCESS_ONCE(c->state) == Q_CELL_TOP && ACCESS_ONCE(q->enq_pos) <= i) {
+            return -ENOENT;
+        }
+    } else if ((ei > 0 && cmpxchg2(&e->id, ei, -i)) || (ei == -i && ACCESS_ONCE(c->state) == Q_CELL_TOP)) {
+        advance_pos(&q->enq_pos, i);
+        cmpxchg16(c, Q_PAIR(0, Q_CELL_TOP), Q_PAIR(ev, Q_CELL_FULL));
+    }
+
+    return ACCESS_ONCE(c->state) == Q_CELL_FULL ? 0 : -EAGAIN;
+}
+
+/* seg is where the fast path started, id the last cell it lost */
+static void enq_slow(struct queue* q, int tid, uval_t v, struct q_seg* seg, long id) {
+    struct q_enq_req* e = &q->enq_reqs[tid];
+    struct q_seg* s = seg;
+    struct q_cell* c;
+    long i;
+
+    q->threads[tid].nr_slow++;
+
+    /* whichever cell we get must be reachable from seg */
+    if (id < seg->id * Q_SEG_SIZE) {
+        id = seg->id * Q_SEG_SIZE;
+    }
+    e->v = v;
+    barrier();
+    ACCESS_ONCE(e->id) = id;
+
+    do {
+        i = xadd2(&q->enq_pos, 1);
+        q_preempt();
+        c = find_cell(&s, i);
+        if (c && cmpxchg2(&c->enq, NULL, e) && ACCESS_ONCE(c->state) != Q_CELL_TOP) {
+            /* a popper may have found us a cell already */
+            cmpxchg2(&e->id, id, -i);
+            break;
+        }
+    } while(ACCESS_ONCE(e->id) > 0);
+
+    i = -ACCESS_ONCE(e->id);
+    c = find_cell(&seg, i);
+    advance_pos(&q->enq_pos, i);
+    /* the popper that claimed it for us may have filled it already */
+    if (!cmpxchg16(c, Q_PAIR(0, Q_CELL_EMPTY), Q_PAIR(v, Q_CELL_FULL))) {
+        cmpxchg16(c, Q_PAIR(0, Q_CELL_TOP), Q_PAIR(v, Q_CELL_FULL));
+    }
+}
+
+void q_push(struct queue* q, uval_t v, int tid) {
+    struct q_seg *seg, *start;
+    struct q_cell* c;
+    long i = 0;
+    int p;
+
+    ebr_enter(q->ebr, tid);
+    q_seen(q, tid);
+
+    start = seg = ACCESS_ONCE(q->tail);
+    for (p = 0; p < Q_PATIENCE; p++) {
+        i = xadd2(&q->enq_pos, 1);
+        q_preempt();
+        c = find_cell(&seg, i);
+        /* fails only if a popper gave up on this cell */
+        if (c && cmpxchg16(c, Q_PAIR(0, Q_CELL_EMPTY), Q_PAIR(v, Q_CELL_FULL))) {
+            break;
+        }
+    }
+    if (p == Q_PATIENCE) {
+        enq_slow(q, tid, v, start, i);
+    }
+    advance_seg(&q->tail, seg);
+
+    ebr_exit(q->ebr, tid);
+}
+
+/*
+ * find r a cell past its id, one with a value nobody took or one that
+ * shows the queue empty. the candidate is announced in r->idx first, so
+ * every helper works on the same cell and r gets one at most.
+ */
+static void help_deq(struct queue* q, int tid, struct q_deq_req* r) {
+    struct q_seg *seg, *s;
+    struct q_cell* c;
+    long id, idx, i, old, new, prev;
+    int ret;
+
+    idx = ACCESS_ONCE(r->idx);
+    id = ACCESS_ONCE(r->id);
+    /* never used, or done */
+    if (id <= 0 || idx < id) {
+        return;
+    }
+    seg = ACCESS_ONCE(r->seg);
+    barrier();
+    /* still pending after we read seg, so seg was pinned before we came */
+    idx = ACCESS_ONCE(r->idx);
+    if (idx < id || ACCESS_ONCE(r->id) != id) {
+        return;
+    }
+
+    i = id + 1;
+    if (i < seg->id * Q_SEG_SIZE) {
+        i = seg->id * Q_SEG_SIZE;
+    }
+    old = id;
+    new = 0;
+    while(1) {
+        s = seg;
+        for (; idx == old && !new; i++) {
+            c = find_cell(&s, i);
+            advance_pos(&q->deq_pos, i);
+            ret = help_enq(q, tid, c, i);
+            if (ret == -ENOENT || (!ret && !ACCESS_ONCE(c->deq))) {
+                new = i;
+            } else {
+                idx = ACCESS_ONCE(r->idx);
+            }
+        }
+        if (new) {
+            prev = cmpxchg(&r->idx, idx, new);
+            idx = prev == idx ? new : prev;
+            if (idx >= new) {
+                new = 0;
+            }
+        }
+        if (idx < 0 || ACCESS_ONCE(r->id) != id) {
+            break;
+        }
+        s = seg;
+        c = find_cell(&s, idx);
+        /* a Q_CELL_TOP candidate stays one, it says empty */
+        if (ACCESS_ONCE(c->state) == Q_CELL_TOP || cmpxchg2(&c->deq, NULL, r) || ACCESS_ONCE(c->deq) == r) {
+            cmpxchg2(&r->idx, idx, -idx);
+            break;
+        }
+        /* its popper was faster, look further */
+        old = idx;
+        if (idx >= i) {
+            i = idx + 1;
+        }
+    }
+}
+
+static int deq_slow(struct queue* q, int tid, uval_t* v, long id) {
+    struct q_deq_req* r = &q->deq_reqs[tid];
+    struct q_seg* seg;
+    struct q_cell* c;
+    long i;
+    int ret;
+
+    q->threads[tid].nr_slow++;
+
+    /* keeps clean() off the base from here on, see there */
+    xadd(&q->nr_deq_reqs, 1);
+    seg = ACCESS_ONCE(q->base);
+    r->seg = seg;
+    ACCESS_ONCE(r->id) = id;
+    barrier();
+    ACCESS_ONCE(r->idx) = id;
+
+    help_deq(q, tid, r);
+
+    i = -ACCESS_ONCE(r->idx);
+    c = find_cell(&seg, i);
+    advance_pos(&q->deq_pos, i);
+    ret = ACCESS_ONCE(c->state) == Q_CELL_FULL ? 0 : -ENOENT;
+    if (!ret) {
+        *v = c->v;
+    }
+
+    barrier();
+    xadd(&q->nr_deq_reqs, -1);
+
+    return ret;
+}
+
+int q_pop(struct queue* q, uval_t* v, int tid) {
+    struct q_thread* th = &q->threads[tid];
+    struct q_seg* seg;
+    struct q_cell* c;
+    long i = 0;
+    int p, ret = -ENOENT;
+
+    ebr_enter(q->ebr, tid);
+    q_seen(q, tid);
+
+    seg = ACCESS_ONCE(q->head);
+    /* do not poison cells of an empty queue for nothing */
+    if (ACCESS_ONCE(q->deq_pos) >= ACCESS_ONCE(q->enq_pos)) {
+        goto out;
+    }
+
+    for (p = 0; p < Q_PATIENCE; p++) {
+        i = xadd2(&q->deq_pos, 1);
+        c = find_cell(&seg, i);
+        ret = help_enq(q, tid, c, i);
+        if (ret == -ENOENT) {
+            break;
+        }
+        if (!ret && cmpxchg2(&c->deq, NULL, Q_REQ_TOP)) {
+            *v = c->v;
+            break;
+        }
+        /* the value went to a pop request */
+        ret = -EAGAIN;
+    }
+    if (ret == -EAGAIN) {
+        ret = deq_slow(q, tid, v, i);
+    }
+
+    if (!ret) {
+        help_deq(q, tid, &q->deq_reqs[th->deq_peer]);
+        th->deq_peer = (th->deq_peer + 1) % ACCESS_ONCE(q->nr_threads);
+    }
+    if (advance_seg(&q->head, seg)) {
+        clean(q, tid);
+    }
+
+out:
+    ebr_exit(q->ebr, tid);
+    return ret;
+}
+
+/* the first published item, pushes still in flight are not waited for */
+int q_front(struct queue* q, uval_t* v, int tid) {
+    struct q_seg* seg;
+    struct q_cell* c;
+    long i, end;
+
+    ebr_enter(q->ebr, tid);
+
+    seg = ACCESS_ONCE(q->head);
+    end = ACCESS_ONCE(q->enq_pos);
+    for (i = ACCESS_ONCE(q->deq_pos); i < end; i++) {
+        c = find_cell(&seg, i);
+        if (ACCESS_ONCE(c->state) == Q_CELL_FULL && !ACCESS_ONCE(c->deq)) {
+            *v = c->v;
+            ebr_exit(q->ebr, tid);
+            return 0;
+        }
+    }
+
+    ebr_exit(q->ebr, tid);
+    return -ENOENT;
+}
+
+unsigned long q_slow_ops(struct queue* q) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < MAX_NUM_THREADS; i++) {
+        sum += ACCESS_ONCE(q->threads[i].nr_slow);
+    }
+    return sum;
+}
@@ -0,0 +1,111 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "util.h"
+#include "ebr.h"
+#include "taslock.h"
+
+/*
+ * wait-free fetch-and-add queue, after Yang and Mellor-Crummey. pushers
+ * and poppers claim cells of an endless array, cut into segments, with
+ * one xadd on a global position. a popper that gets to a cell first
+ * poisons it and both move on to the next one.
+ *
+ * after Q_PATIENCE lost cells an operation publishes a request in its
+ * own record. a popper about to poison a cell puts a pending push there
+ * instead, and every pop that got a value helps one pending pop, so a
+ * request is done within a bounded number of steps of the others.
+ *
+ * drained segments are retired with EBR, but not while a pop request is
+ * pending, its helpers may still walk the cells behind the head.
+ */
+#define Q_SEG_SIZE      1024
+
+/* fast-path cells an operation may lose before it asks for help */
+#ifndef Q_PATIENCE
+#define Q_PATIENCE      10
+#endif
+#if Q_PATIENCE < 1
+#error "a request needs the position of a lost cell"
+#endif
+
+/* pause loops a popper gives an in-flight push before it poisons the cell */
+#ifndef Q_SPIN
+#define Q_SPIN          100
+#endif
+
+#define Q_CELL_EMPTY    0
+#define Q_CELL_FULL     1
+/* no push will land here except a helped request */
+#define Q_CELL_TOP      2
+
+/* marks the enq or deq slot of a cell as taken by its own thread */
+#define Q_REQ_TOP       ((void*) 1)
+
+/* a pending push, id > 0 since which cell, -i once cell i is its */
+struct q_enq_req {
+    uval_t v;
+    long id;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+/* idx == id pending, idx > id a candidate cell, -idx done */
+struct q_deq_req {
+    long id;
+    long idx;
+    /* helpers walk from here, it is kept from being retired */
+    struct q_seg* seg;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+/* whom this thread helps next */
+struct q_thread {
+    int enq_peer;
+    long enq_id;
+    int deq_peer;
+    unsigned long nr_slow;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+/* v and state are swapped together, that takes cmpxchg16b (-mcx16) */
+struct q_cell {
+    uval_t v;
+    unsigned long state;
+    struct q_enq_req* enq;
+    struct q_deq_req* deq;
+} __attribute__((aligned(16)));
+
+struct q_seg {
+    long id;
+    struct q_seg* next;
+    struct q_cell cells[Q_SEG_SIZE] __attribute__((aligned(CACHELINE_SIZE)));
+};
+
+struct queue {
+    /* pushers */
+    long enq_pos __attribute__((aligned(CACHELINE_SIZE)));
+    /* poppers */
+    long deq_pos __attribute__((aligned(CACHELINE_SIZE)));
+    struct q_seg* tail __attribute__((aligned(CACHELINE_SIZE)));
+    struct q_seg* head __attribute__((aligned(CACHELINE_SIZE)));
+    /* oldest segment not retired yet */
+    struct q_seg* base __attribute__((aligned(CACHELINE_SIZE)));
+    /* pop requests in flight, no retiring while there are some */
+    int nr_deq_reqs;
+    tas_lock_t clean_lock;
+    int nr_threads;
+    struct ebr* ebr;
+    struct q_enq_req enq_reqs[MAX_NUM_THREADS];
+    struct q_deq_req deq_reqs[MAX_NUM_THREADS];
+    struct q_thread threads[MAX_NUM_THREADS];
+};
+
+extern struct queue* q_create();
+extern void q_destroy(struct queue* q);
+extern void q_push(struct queue* q, uval_t v, int tid);
+extern int q_pop(struct queue* q, uval_t* v, int tid);
+extern int q_front(struct queue* q, uval_t* v, int tid);
+/* operations that went down the slow path so far */
+extern unsigned long q_slow_ops(struct queue* q);
+
+#endif
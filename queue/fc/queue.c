@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "queue.h"
+#include "atomic.h"
+
+#define Q_PUSH  1
+#define Q_POP   2
+#define Q_FRONT 3
+
+static struct q_node* alloc_node(uval_t v) {
+    struct q_node* node = (struct q_node*) malloc(sizeof(struct q_node));
+
+    node->next = NULL;
+    node->v = v;
+
+    return node;
+}
+
+static void free_node(struct q_node* node) {
+    free(node);
+}
+
+struct queue* q_create() {
+    struct queue* q = (struct queue*) aligned_alloc(__alignof__(struct queue), sizeof(struct queue));
+
+    q->head = NULL;
+    q->tail = NULL;
+    fc_init(&q->fc);
+
+    return q;
+}
+
+void q_destroy(struct queue* q) {
+    struct q_node *pred, *curr;
+
+    pred = q->head;
+
+    while(pred) {
+        curr = pred->next;
+        free_node(pred);
+        pred = curr;
+    }
+
+    free(q);
+}
+
+/*
+ * pushes of a pass are held back and linked at the end, in order. a pop
+ * that finds the list empty takes the oldest held-back push instead, so
+ * the pair never touches the list. nodes are allocated and freed by
+ * their owners, outside the lock.
+ */
+static void q_combine(void* arg, struct fc_record* recs, int nr) {
+    struct queue* q = (struct queue*) arg;
+    struct fc_record* pushes[MAX_NUM_THREADS];
+    struct fc_record* rec;
+    struct q_node* node;
+    int st = 0, ed = 0, i;
+
+    for (i = 0; i < nr; i++) {
+        rec = &recs[i];
+        switch (ACCESS_ONCE(rec->op)) {
+        case Q_PUSH:
+            pushes[ed++] = rec;
+            break;
+        case Q_POP:
+            if (q->head) {
+                node = q->head;
+                q->head = node->next;
+                if (!q->head) {
+                    q->tail = NULL;
+                }
+                rec->v = (uval_t) node;
+                fc_done(rec, 0);
+            } else if (st < ed) {
+                rec->v = pushes[st]->v;
+                fc_done(pushes[st++], 0);
+                fc_done(rec, 0);
+            } else {
+                fc_done(rec, -ENOENT);
+            }
+            break;
+        case Q_FRONT:
+            node = q->head ? q->head : (st < ed ? (struct q_node*) pushes[st]->v : NULL);
+            if (node) {
+                rec->v = node->v;
+                fc_done(rec, 0);
+            } else {
+                fc_done(rec, -ENOENT);
+            }
+            break;
+        }
+    }
+
+    for (i = st; i < ed; i++) {
+        node = (struct q_node*) pushes[i]->v;
+        if (q->tail) {
+            q->tail->next = node;
+        } else {
+            q->head = node;
+        }
+        q->tail = node;
+        fc_done(pushes[i], 0);
+    }
+}
+
+void q_push(struct queue* q, uval_t v, int tid) {
+    uval_t node = (uval_t) alloc_node(v);
+
+    fc_request(&q->fc, tid, Q_PUSH, &node, q_combine, q);
+}
+
+int q_pop(struct queue* q, uval_t* v, int tid) {
+    struct q_node* node;
+    uval_t ret_v = 0;
+
+    if (fc_request(&q->fc, tid, Q_POP, &ret_v, q_combine, q)) {
+        *v = 0;
+        return -ENOENT;
+    }
+    node = (struct q_node*) ret_v;
+    *v = node->v;
+    free_node(node);
+
+    return 0;
+}
+
+int q_front(struct queue* q, uval_t* v, int tid) {
+    *v = 0;
+    return fc_request(&q->fc, tid, Q_FRONT, v, q_combine, q);
+}
@@ -0,0 +1,32 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "util.h"
+#include "flat_combining.h"
+
+/*
+ * flat-combining queue. the combiner applies everybody's requests to a
+ * plain linked list, nothing else ever touches it, so there is no CAS
+ * and nothing to reclaim.
+ */
+struct q_node {
+    uval_t v;
+    struct q_node* next;
+};
+
+struct queue {
+    struct q_node* head;
+    struct q_node* tail;
+    struct fc fc;
+};
+
+extern struct queue* q_create();
+extern void q_destroy(struct queue* q);
+extern void q_push(struct queue* q, uval_t v, int tid);
+extern int q_pop(struct queue* q, uval_t* v, int tid);
+extern int q_front(struct queue* q, uval_t* v, int tid);
+
+#endif
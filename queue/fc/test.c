@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+
+#ifdef __APPLE__
+#include "pthread_barrier.h"
+#endif
+#include "queue.h"
+#include "atomic.h"
+
+#define N           10000000
+/*NUM_THREAD HAS TO BE AN ODD*/
+#define NUM_THREAD  8
+
+#define RAND
+// #define DETAIL
+#define ASSERT
+
+#ifdef DETAIL
+#define test_print(fmt, args ...) do{printf(fmt, ##args);}while(0)
+#else
+#define test_print(fmt, args ...) do{}while(0)
+#endif
+
+#ifdef ASSERT
+#define test_assert(arg) do{assert(arg);}while(0)
+#else
+#define test_assert(arg) do{}while(0)
+#endif
+
+__thread struct timeval t0, t1;
+
+pthread_barrier_t barrier;
+pthread_t tids[NUM_THREAD];
+
+ukey_t k[N];
+uval_t v[N];
+
+struct queue* q;
+
+uval_t popped;
+
+static void gen_data() {
+    int i;
+
+    for (i = 0; i < N; i++) {
+        k[i] = i + 1;
+        v[i] = i + 1;
+    }
+
+#ifdef RAND
+    ukey_t temp_k;
+    uval_t temp_v;
+    int idx;
+
+    srand(time(0));
+    for (i = 0; i < N; i++) {
+        idx = rand() % N;
+        temp_k = k[i];
+        k[i] = k[idx];
+        k[idx] = temp_k;
+        temp_v = v[i];
+        v[i] = v[idx];
+        v[idx] = temp_v;
+    }
+#endif
+}
+
+static void start_measure() {
+    gettimeofday(&t0, NULL);
+}
+
+static double end_measure() {
+    gettimeofday(&t1, NULL);
+    return t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) / 1e6;
+}
+
+static void do_barrier(long id, const char* arg) {
+    pthread_barrier_wait(&barrier);
+    if (id == 0) {
+        printf("%s finished in %.3lf seconds\n", arg, end_measure());
+    }
+}
+
+/* pop exactly the slice's count, an empty queue only means the pushers lag */
+static void do_push(long id, int nr_threads) {
+    int st, ed, i;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / nr_threads * N;
+    ed = 1.0 * (id + 1) / nr_threads * N;
+
+    for (i = st; i < ed; i++) {
+        q_push(q, v[i], (int) id);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+/* slice picks the share of v[], id stays the caller's own thread id */
+static void do_pop(long id, long slice, int nr_threads) {
+    int st, ed, i;
+    double interval;
+    uval_t v0, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * slice / nr_threads * N;
+    ed = 1.0 * (slice + 1) / nr_threads * N;
+
+    for (i = st; i < ed; i++) {
+        while(q_pop(q, &v0, (int) id)) {
+            sched_yield();
+        }
+        sum += v0;
+    }
+    xadd(&popped, sum);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+void* push_fun(void* arg) {
+    long id = (long) arg;
+
+    do_push(id, NUM_THREAD / 2);
+
+    do_barrier(id, "PUSH & POP");
+
+    do_push(id, NUM_THREAD);
+
+    do_barrier(id, "PUSH");
+
+    do_pop(id, id, NUM_THREAD);
+
+    do_barrier(id, "POP");
+
+    return NULL;
+}
+
+void* pop_fun(void* arg) {
+    long id = (long) arg;
+
+    do_pop(id, id - NUM_THREAD / 2, NUM_THREAD / 2);
+
+    do_barrier(id, "PUSH & POP");
+
+    do_push(id, NUM_THREAD);
+
+    do_barrier(id, "PUSH");
+
+    do_pop(id, id, NUM_THREAD);
+
+    do_barrier(id, "POP");
+
+    return NULL;
+}
+
+int main() {
+    long i;
+    uval_t sum = 0;
+
+    gen_data();
+
+    q = q_create();
+    
+    pthread_barrier_init(&barrier, NULL, NUM_THREAD);
+
+    for (i = 0; i < NUM_THREAD / 2; i++) {
+        pthread_create(&tids[i], NULL, push_fun, (void*) i);
+        pthread_create(&tids[NUM_THREAD / 2 + i], NULL, pop_fun, (void*) (NUM_THREAD / 2 + i));
+    }
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    /* both rounds moved every item of v[] exactly once */
+    for (i = 0; i < N; i++) {
+        sum += v[i];
+    }
+    test_assert(popped == 2 * sum);
+    test_assert(q_front(q, &v[0], 0) == -ENOENT);
+
+    q_destroy(q);
+
+    return 0;
+}
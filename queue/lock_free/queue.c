@@ -5,9 +5,12 @@
 
 #include "queue.h"
 #include "atomic.h"
+#include "backoff.h"
+
+static __thread struct backoff q_backoff;
 
 static struct q_node* alloc_node(uval_t v) {
-    struct q_node* node = (struct q_node*) malloc(sizeof(struct q_node));
+    struct q_node* node = (struct q_node*) aligned_alloc(__alignof__(struct q_node), sizeof(struct q_node));
 
     node->next = NULL;
     node->v = v;
@@ -20,13 +23,14 @@ static void free_node(struct q_node* node) {
 }
 
 struct queue* q_create() {
-    struct queue* q = (struct queue*) malloc(sizeof(struct queue));
+    struct queue* q = (struct queue*) aligned_alloc(__alignof__(struct queue), sizeof(struct queue));
     struct q_node* node = alloc_node(0);
     
     q->head = node;
     q->tail = node;
 
     q->ebr = ebr_create((free_fun_t) free_node);
+    ec_init(&q->ec);
 
     return q;
 }
@@ -61,8 +65,49 @@ void q_push(struct queue* q, uval_t v, int tid) {
                 if (cmpxchg2(&last->next, next, node)) {
                     cmpxchg2(&q->tail, last, node);
                     ebr_exit(q->ebr, tid);
+                    backoff_done(&q_backoff);
+                    ec_notify_after_rmw(&q->ec);
                     return;
                 }
+                backoff_wait(&q_backoff);
+            } else {
+                cmpxchg2(&q->tail, last, next);
+            }
+        }
+    }
+}
+
+/* link a private chain of len nodes with one CAS, then swing tail to its end */
+void q_push_batch(struct queue* q, uval_t* v_arr, int len, int tid) {
+    struct q_node *first, *end, *last, *next;
+    int i;
+
+    if (len <= 0) {
+        return;
+    }
+
+    first = end = alloc_node(v_arr[0]);
+    for (i = 1; i < len; i++) {
+        end->next = alloc_node(v_arr[i]);
+        end = end->next;
+    }
+
+    ebr_enter(q->ebr, tid);
+
+    while(1) {
+        last = q->tail;
+        next = last->next;
+        if (last == q->tail) {
+            if (next == NULL) {
+                if (cmpxchg2(&last->next, next, first)) {
+                    /* others help the tail along the chain if this one fails */
+                    cmpxchg2(&q->tail, last, end);
+                    ebr_exit(q->ebr, tid);
+                    backoff_done(&q_backoff);
+                    ec_notify_after_rmw(&q->ec);
+                    return;
+                }
+                backoff_wait(&q_backoff);
             } else {
                 cmpxchg2(&q->tail, last, next);
             }
@@ -84,6 +129,7 @@ int q_pop(struct queue* q, uval_t* v, int tid) {
             if (first == last) {
                 if (next == NULL) {
                     ebr_exit(q->ebr, tid);
+                    backoff_done(&q_backoff);
                     return -ENOENT;
                 }
                 cmpxchg2(&q->tail, last, next);
@@ -92,13 +138,97 @@ int q_pop(struct queue* q, uval_t* v, int tid) {
                 if (cmpxchg2(&q->head, first, next)) {
                     ebr_put(q->ebr, first, tid);
                     ebr_exit(q->ebr, tid);
+                    backoff_done(&q_backoff);
                     return 0;
                 }
+                backoff_wait(&q_backoff);
             }
         }
     }
 }
 
+/*
+ * claim up to len items with one head CAS. tail is read after head, so
+ * it is not behind first, and the walk stops there: head never passes
+ * tail.
+ */
+int q_pop_batch(struct queue* q, uval_t* v_arr, int len, int tid) {
+    struct q_node *first, *last, *next, *node;
+    int cnt;
+
+    if (len <= 0) {
+        return 0;
+    }
+
+    ebr_enter(q->ebr, tid);
+
+    while(1) {
+        first = q->head;
+        last = q->tail;
+        next = first->next;
+        if (first != q->head) {
+            continue;
+        }
+        if (first == last) {
+            if (next == NULL) {
+                ebr_exit(q->ebr, tid);
+                backoff_done(&q_backoff);
+                return -ENOENT;
+            }
+            cmpxchg2(&q->tail, last, next);
+            continue;
+        }
+
+        /* first != last, so next and everything up to last is linked */
+        node = next;
+        for (cnt = 1; cnt < len && node != last; cnt++) {
+            node = node->next;
+        }
+        if (cmpxchg2(&q->head, first, node)) {
+            break;
+        }
+        backoff_wait(&q_backoff);
+    }
+    backoff_done(&q_backoff);
+
+    /* node is the new dummy, the ones before it are ours */
+    for (cnt = 0; first != node; cnt++) {
+        next = first->next;
+        v_arr[cnt] = next->v;
+        ebr_put(q->ebr, first, tid);
+        first = next;
+    }
+    ebr_exit(q->ebr, tid);
+
+    return cnt;
+}
+
+/* spin on q_pop() for a while, then sleep until a push comes in */
+void q_pop_wait(struct queue* q, uval_t* v, int tid) {
+    unsigned int key, budget = ec_spin_budget(&q->ec), i;
+
+    for (i = 0; i < budget; i++) {
+        if (!q_pop(q, v, tid)) {
+            /* only count it when spinning is what got the item */
+            if (i) {
+                ec_spun(&q->ec, 1);
+            }
+            return;
+        }
+        cpu_relax();
+    }
+    ec_spun(&q->ec, 0);
+
+    while(1) {
+        key = ec_prepare_wait(&q->ec);
+        if (!q_pop(q, v, tid)) {
+            ec_cancel_wait(&q->ec);
+            return;
+        }
+        ec_wait(&q->ec, key);
+    }
+}
+
 int q_front(struct queue* q, uval_t* v, int tid) {
     struct q_node *first, *last, *next;
 
@@ -6,21 +6,39 @@
 
 #include "util.h"
 #include "ebr.h"
+#include "eventcount.h"
 
+/* build with -D Q_NO_PADDING to pack the hot fields as before */
+#ifndef Q_NO_PADDING
+#define Q_ALIGNED   __attribute__((aligned(CACHELINE_SIZE)))
+#else
+#define Q_ALIGNED
+#endif
+
+/* a node per line, so linking one node does not disturb a pop of its neighbour */
 struct q_node {
     uval_t v;
     struct q_node* next;
-};
+} Q_ALIGNED;
 
 struct queue {
-    struct q_node *head, *tail;
-    struct ebr* ebr;
+    /* poppers */
+    struct q_node* head Q_ALIGNED;
+    /* pushers */
+    struct q_node* tail Q_ALIGNED;
+    /* read-mostly */
+    struct ebr* ebr Q_ALIGNED;
+    /* poppers parked in q_pop_wait() */
+    struct eventcount ec;
 };
 
 extern struct queue* q_create();
 extern void q_destroy(struct queue* q);
 extern void q_push(struct queue* q, uval_t v, int tid);
+extern void q_push_batch(struct queue* q, uval_t* v_arr, int len, int tid);
 extern int q_pop(struct queue* q, uval_t* v, int tid);
+extern int q_pop_batch(struct queue* q, uval_t* v_arr, int len, int tid);
+extern void q_pop_wait(struct queue* q, uval_t* v, int tid);
 extern int q_front(struct queue* q, uval_t* v, int tid);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sched.h>
+
+#include "ring.h"
+#include "atomic.h"
+
+/* pause loops before a blocked push or pop gives its core away */
+#define RQ_YIELD_LOOPS      1024
+
+static inline void rq_wait(unsigned int* spins) {
+    cpu_relax();
+    if (++*spins == RQ_YIELD_LOOPS) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+/* size is rounded up to a power of two */
+struct ring* rq_create(unsigned long size) {
+    struct ring* rq = (struct ring*) aligned_alloc(CACHELINE_SIZE, sizeof(struct ring));
+    unsigned long cap = 1, i;
+
+    while(cap < size) {
+        cap <<= 1;
+    }
+
+    rq->head = 0;
+    rq->tail = 0;
+    rq->mask = cap - 1;
+    /* aligned_alloc() wants a multiple of the alignment, small rings fall short */
+    rq->cells = (struct rq_cell*) aligned_alloc(CACHELINE_SIZE,
+        (cap * sizeof(struct rq_cell) + CACHELINE_SIZE - 1) & ~(CACHELINE_SIZE - 1UL));
+    for (i = 0; i < cap; i++) {
+        rq->cells[i].seq = i;
+    }
+
+    return rq;
+}
+
+void rq_destroy(struct ring* rq) {
+    free(rq->cells);
+    free(rq);
+}
+
+int rq_try_push(struct ring* rq, uval_t v) {
+    struct rq_cell* cell;
+    unsigned long pos = ACCESS_ONCE(rq->tail), old;
+    long dif;
+
+    while(1) {
+        cell = &rq->cells[pos & rq->mask];
+        dif = (long) ACCESS_ONCE(cell->seq) - (long) pos;
+        if (dif == 0) {
+            old = cmpxchg(&rq->tail, pos, pos + 1);
+            if (old == pos) {
+                break;
+            }
+            pos = old;
+        } else if (dif < 0) {
+            /* the popper of the previous lap is not done, full */
+            return -ENOBUFS;
+        } else {
+            pos = ACCESS_ONCE(rq->tail);
+        }
+    }
+
+    cell->v = v;
+    /* x86 keeps stores in order, v is visible before the new seq */
+    barrier();
+    ACCESS_ONCE(cell->seq) = pos + 1;
+
+    return 0;
+}
+
+void rq_push(struct ring* rq, uval_t v) {
+    unsigned int spins = 0;
+
+    while(rq_try_push(rq, v)) {
+        rq_wait(&spins);
+    }
+}
+
+int rq_try_pop(struct ring* rq, uval_t* v) {
+    struct rq_cell* cell;
+    unsigned long pos = ACCESS_ONCE(rq->head), old;
+    long dif;
+
+    while(1) {
+        cell = &rq->cells[pos & rq->mask];
+        dif = (long) ACCESS_ONCE(cell->seq) - (long) (pos + 1);
+        if (dif == 0) {
+            old = cmpxchg(&rq->head, pos, pos + 1);
+            if (old == pos) {
+                break;
+            }
+            pos = old;
+        } else if (dif < 0) {
+            /* no pusher got to this cell yet, empty */
+            return -ENOENT;
+        } else {
+            pos = ACCESS_ONCE(rq->head);
+        }
+    }
+
+    *v = cell->v;
+    barrier();
+    /* hand the cell to the pusher of the next lap */
+    ACCESS_ONCE(cell->seq) = pos + rq->mask + 1;
+
+    return 0;
+}
+
+void rq_pop(struct ring* rq, uval_t* v) {
+    unsigned int spins = 0;
+
+    while(rq_try_pop(rq, v)) {
+        rq_wait(&spins);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "util.h"
+
+/*
+ * bounded MPMC queue (Vyukov). every cell carries a sequence number that
+ * tells whose turn it is: pos for the pusher of lap pos, pos + 1 for the
+ * popper. no allocation and no reclamation after rq_create().
+ */
+struct rq_cell {
+    unsigned long seq;
+    uval_t v;
+};
+
+struct ring {
+    /* written by pushers */
+    unsigned long tail __attribute__((aligned(CACHELINE_SIZE)));
+    /* written by poppers */
+    unsigned long head __attribute__((aligned(CACHELINE_SIZE)));
+    /* read-only after rq_create */
+    unsigned long mask __attribute__((aligned(CACHELINE_SIZE)));
+    struct rq_cell* cells;
+};
+
+extern struct ring* rq_create(unsigned long size);
+extern void rq_destroy(struct ring* rq);
+extern int rq_try_push(struct ring* rq, uval_t v);
+extern void rq_push(struct ring* rq, uval_t v);
+extern int rq_try_pop(struct ring* rq, uval_t* v);
+extern void rq_pop(struct ring* rq, uval_t* v);
+
+#endif
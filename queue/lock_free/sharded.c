@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "sharded.h"
+
+struct sharded_queue* sq_create(int nr_lanes, unsigned int relax) {
+    struct sharded_queue* sq = (struct sharded_queue*) aligned_alloc(CACHELINE_SIZE,
+                               sizeof(struct sharded_queue) + nr_lanes * sizeof(struct sq_lane));
+    int i;
+
+    sq->nr_lanes = nr_lanes;
+    sq->relax = relax;
+    for (i = 0; i < nr_lanes; i++) {
+        sq->lanes[i].q = q_create();
+        sq->lanes[i].pushed = 0;
+        sq->lanes[i].popped = 0;
+    }
+
+    return sq;
+}
+
+void sq_destroy(struct sharded_queue* sq) {
+    int i;
+
+    for (i = 0; i < sq->nr_lanes; i++) {
+        q_destroy(sq->lanes[i].q);
+    }
+    free(sq);
+}
+
+/* every lane has its own EBR */
+void sq_thread_register(struct sharded_queue* sq, int tid) {
+    int i;
+
+    for (i = 0; i < sq->nr_lanes; i++) {
+        ebr_thread_register(sq->lanes[i].q->ebr, tid);
+    }
+}
+
+void sq_thread_unregister(struct sharded_queue* sq, int tid) {
+    int i;
+
+    for (i = 0; i < sq->nr_lanes; i++) {
+        ebr_thread_unregister(sq->lanes[i].q->ebr, tid);
+    }
+}
+
+/* the lane with the fewest pushes */
+static int push_laggard(struct sharded_queue* sq, unsigned long* min) {
+    unsigned long n;
+    int i, lane = 0;
+
+    *min = ACCESS_ONCE(sq->lanes[0].pushed);
+    for (i = 1; i < sq->nr_lanes; i++) {
+        n = ACCESS_ONCE(sq->lanes[i].pushed);
+        if (n < *min) {
+            *min = n;
+            lane = i;
+        }
+    }
+
+    return lane;
+}
+
+/* the oldest head, -1 if every lane looks empty */
+static int pop_laggard(struct sharded_queue* sq, unsigned long* min) {
+    unsigned long n;
+    int i, lane = -1;
+
+    *min = 0;
+    for (i = 0; i < sq->nr_lanes; i++) {
+        n = ACCESS_ONCE(sq->lanes[i].popped);
+        if (n < ACCESS_ONCE(sq->lanes[i].pushed) && (lane < 0 || n < *min)) {
+            *min = n;
+            lane = i;
+        }
+    }
+
+    return lane;
+}
+
+void sq_push(struct sharded_queue* sq, uval_t v, int tid) {
+    int lane = tid % sq->nr_lanes, i;
+    unsigned long min;
+
+    if (!sq->relax) {
+        q_push(sq->lanes[lane].q, v, tid);
+        return;
+    }
+
+    /* home only while it is less than relax pushes ahead */
+    i = push_laggard(sq, &min);
+    if (ACCESS_ONCE(sq->lanes[lane].pushed) >= min + sq->relax) {
+        lane = i;
+    }
+    q_push(sq->lanes[lane].q, v, tid);
+    xadd(&sq->lanes[lane].pushed, 1);
+}
+
+/* only lanes within relax pops of the oldest head are tried */
+static int pop_bounded(struct sharded_queue* sq, uval_t* v, int tid) {
+    struct sq_lane* lane = &sq->lanes[tid % sq->nr_lanes];
+    unsigned long min;
+    int oldest = pop_laggard(sq, &min), i;
+
+    if (oldest < 0) {
+        return -ENOENT;
+    }
+
+    if (ACCESS_ONCE(lane->popped) < min + sq->relax && !q_pop(lane->q, v, tid)) {
+        xadd(&lane->popped, 1);
+        return 0;
+    }
+
+    for (i = 0; i < sq->nr_lanes; i++) {
+        lane = &sq->lanes[(oldest + i) % sq->nr_lanes];
+        if (ACCESS_ONCE(lane->popped) < min + sq->relax && !q_pop(lane->q, v, tid)) {
+            xadd(&lane->popped, 1);
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* -ENOENT only after every lane was found empty */
+int sq_pop(struct sharded_queue* sq, uval_t* v, int tid) {
+    int lane, i;
+
+    if (sq->relax && !pop_bounded(sq, v, tid)) {
+        return 0;
+    }
+
+    /*
+     * with relax the counters trail the lanes, the lanes within the bound
+     * may be empty or being popped while the others still hold items
+     */
+    for (i = 0; i < sq->nr_lanes; i++) {
+        lane = (tid + i) % sq->nr_lanes;
+        if (!q_pop(sq->lanes[lane].q, v, tid)) {
+            if (sq->relax) {
+                xadd(&sq->lanes[lane].popped, 1);
+            }
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
@@ -0,0 +1,39 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include "util.h"
+#include "queue.h"
+
+/*
+ * relaxed FIFO over several MS queues. every thread pushes to and pops
+ * from its home lane and only steals from the others when that one is
+ * empty. with relax 0 nothing bounds the order across lanes.
+ *
+ * with relax k > 0 every lane counts its pushes and pops. a push leaves
+ * its home lane for the lane with the fewest pushes once home is k ahead
+ * of it, a pop likewise goes to the oldest head, the non-empty lane with
+ * the fewest pops. a pop then passes over at most (2k - 1) * (nr_lanes - 1)
+ * older items, plus one per operation in flight. when no lane within k
+ * of the oldest head gives an item, because those heads are still being
+ * pushed or popped, the pop takes from any lane rather than fail.
+ */
+struct sq_lane {
+    struct queue* q;
+    unsigned long pushed __attribute__((aligned(CACHELINE_SIZE)));
+    unsigned long popped __attribute__((aligned(CACHELINE_SIZE)));
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+struct sharded_queue {
+    int nr_lanes;
+    unsigned int relax;
+    struct sq_lane lanes[0];
+};
+
+extern struct sharded_queue* sq_create(int nr_lanes, unsigned int relax);
+extern void sq_destroy(struct sharded_queue* sq);
+extern void sq_thread_register(struct sharded_queue* sq, int tid);
+extern void sq_thread_unregister(struct sharded_queue* sq, int tid);
+extern void sq_push(struct sharded_queue* sq, uval_t v, int tid);
+extern int sq_pop(struct sharded_queue* sq, uval_t* v, int tid);
+
+#endif
@@ -6,15 +6,27 @@
 #include <sys/time.h>
 #include <assert.h>
 #include <errno.h>
+#include <sched.h>
 
 #ifdef __APPLE__
 #include "pthread_barrier.h"
 #endif
 #include "queue.h"
+#include "ring.h"
+#include "sharded.h"
+#include "atomic.h"
 
 #define N           10000000
 /*NUM_THREAD HAS TO BE AN ODD*/
 #define NUM_THREAD  8
+#define RING_SIZE   (1 << 16)
+#define BATCH_SIZE  128
+#define SQ_RELAX    64
+/* items of the phase that measures how far sq_pop strays from FIFO */
+#define SQ_BOUND_N  (N / 10)
+/* pops per thread in each round of the phase that checks sq_pop never fails early */
+#define SQ_DRAIN_ITEMS  4
+#define SQ_DRAIN_ROUNDS (N / 1000)
 
 #define RAND
 // #define DETAIL
@@ -42,6 +54,19 @@ ukey_t k[N];
 uval_t v[N];
 
 struct queue* q;
+struct ring* rq;
+struct sharded_queue *sq, *sqk, *sqb, *sqd;
+
+uval_t ring_pushed, ring_popped, wait_popped, batch_popped, split_popped;
+uval_t sharded_popped;
+uval_t drain_popped;
+uval_t bound_log[SQ_BOUND_N];
+int bound_fenwick[SQ_BOUND_N + 1];
+unsigned long bound_seq;
+
+/* pushers of each P/C split, the other threads pop */
+int splits[] = {1, 2, 4, 6, 7};
+#define NR_SPLITS   (sizeof(splits) / sizeof(splits[0]))
 
 static void gen_data() {
     int i;
@@ -122,12 +147,289 @@ static void do_pop(long id, int expect_ret) {
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
 }
 
+static void do_pop_wait(long id) {
+    int st, ed, i;
+    uval_t v, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        q_pop_wait(q, &v, (int) id);
+        sum += v;
+    }
+
+    xadd(&wait_popped, sum);
+}
+
+static void do_push_batch(long id) {
+    int st, ed, i;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i += BATCH_SIZE) {
+        q_push_batch(q, &v[i], (ed - i < BATCH_SIZE) ? ed - i : BATCH_SIZE, (int) id);
+    }
+}
+
+static void do_pop_batch(long id) {
+    int st, ed, i, j, ret;
+    uval_t sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i += ret) {
+        ret = q_pop_batch(q, v_arr, (ed - i < BATCH_SIZE) ? ed - i : BATCH_SIZE, (int) id);
+        if (ret < 0) {
+            test_assert(ret == -ENOENT);
+            ret = 0;
+            continue;
+        }
+        for (j = 0; j < ret; j++) {
+            sum += v_arr[j];
+        }
+    }
+
+    xadd(&batch_popped, sum);
+}
+
+static void do_ring_push(long id) {
+    int st, ed, i;
+    uval_t sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        rq_push(rq, v[i]);
+        sum += v[i];
+    }
+
+    xadd(&ring_pushed, sum);
+}
+
+static void do_ring_pop(long id) {
+    int st, ed, i;
+    uval_t v, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        rq_pop(rq, &v);
+        sum += v;
+    }
+
+    xadd(&ring_popped, sum);
+}
+
+static void do_sharded_push(long id, struct sharded_queue* sq) {
+    int st, ed, i;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        sq_push(sq, v[i], (int) id);
+    }
+}
+
+/* -ENOENT means every lane was empty, the pushers just lag */
+static void do_sharded_pop(long id, struct sharded_queue* sq) {
+    int st, ed, i;
+    uval_t v, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        while(sq_pop(sq, &v, (int) id)) {
+            sched_yield();
+        }
+        sum += v;
+    }
+
+    xadd(&sharded_popped, sum);
+}
+
+/* one pusher, so the order of its pushes is the FIFO order */
+static void do_bound_push(long id) {
+    uval_t i;
+
+    start_measure();
+
+    if (id) {
+        return;
+    }
+    for (i = 1; i <= SQ_BOUND_N; i++) {
+        sq_push(sqb, i, (int) id);
+    }
+}
+
+static void do_bound_pop(long id) {
+    int st, ed, i;
+    uval_t v;
+
+    start_measure();
+
+    st = 1.0 * (id - NUM_THREAD / 2) / (NUM_THREAD / 2) * SQ_BOUND_N;
+    ed = 1.0 * (id - NUM_THREAD / 2 + 1) / (NUM_THREAD / 2) * SQ_BOUND_N;
+
+    for (i = st; i < ed; i++) {
+        while(sq_pop(sqb, &v, (int) id)) {
+            sched_yield();
+        }
+        bound_log[xadd2(&bound_seq, 1)] = v;
+    }
+}
+
+/*
+ * rounds of the pushers filling sqd, then everybody popping as many items
+ * as there are with no pushes going on. none of those pops may fail, and
+ * small rounds keep the pops close to the lanes running dry.
+ */
+static void do_drain(long id) {
+    int round, i;
+    uval_t v0, sum = 0;
+
+    start_measure();
+
+    for (round = 0; round < SQ_DRAIN_ROUNDS; round++) {
+        if (id < NUM_THREAD / 2) {
+            for (i = 0; i < 2 * SQ_DRAIN_ITEMS; i++) {
+                sq_push(sqd, v[round * (NUM_THREAD / 2) + id], (int) id);
+            }
+        }
+        pthread_barrier_wait(&barrier);
+
+        for (i = 0; i < SQ_DRAIN_ITEMS; i++) {
+            test_assert(sq_pop(sqd, &v0, (int) id) == 0);
+            sum += v0;
+        }
+        pthread_barrier_wait(&barrier);
+    }
+
+    xadd(&drain_popped, sum);
+}
+
+/* older items still queued when each item was popped, against the bound in sharded.h */
+static void sharded_bound() {
+    unsigned long max = 0, passed, bound;
+    int i, j, popped_below;
+
+    test_assert(bound_seq == SQ_BOUND_N);
+
+    for (i = 0; i < SQ_BOUND_N; i++) {
+        popped_below = 0;
+        for (j = bound_log[i] - 1; j > 0; j -= j & -j) {
+            popped_below += bound_fenwick[j];
+        }
+        passed = bound_log[i] - 1 - popped_below;
+        if (passed > max) {
+            max = passed;
+        }
+        for (j = bound_log[i]; j <= SQ_BOUND_N; j += j & -j) {
+            bound_fenwick[j]++;
+        }
+    }
+
+    bound = (2UL * SQ_RELAX - 1) * (NUM_THREAD / 2 - 1);
+    printf("SHARDED RELAX %d PASSED OVER max %lu bound %lu\n", SQ_RELAX, max, bound);
+    /* a log slot is taken after the pop, every popper may be one behind */
+    test_assert(max <= bound + NUM_THREAD);
+}
+
+/* N / 2 items go from P pushers to NUM_THREAD - P poppers */
+static void do_split(long id, int nr_push) {
+    int nr_pop = NUM_THREAD - nr_push, m = N / 2, st, ed, i;
+    uval_t v0, sum = 0;
+    char name[32];
+
+    start_measure();
+
+    if (id < nr_push) {
+        st = 1.0 * id / nr_push * m;
+        ed = 1.0 * (id + 1) / nr_push * m;
+        for (i = st; i < ed; i++) {
+            q_push(q, v[i], (int) id);
+        }
+    } else {
+        st = 1.0 * (id - nr_push) / nr_pop * m;
+        ed = 1.0 * (id - nr_push + 1) / nr_pop * m;
+        for (i = st; i < ed; i++) {
+            q_pop_wait(q, &v0, (int) id);
+            sum += v0;
+        }
+        xadd(&split_popped, sum);
+    }
+
+    snprintf(name, sizeof(name), "SPLIT P%d C%d", nr_push, nr_pop);
+    do_barrier(id, name);
+}
+
+static void do_splits(long id) {
+    int i;
+
+    for (i = 0; i < NR_SPLITS; i++) {
+        do_split(id, splits[i]);
+    }
+}
+
 void* push_fun(void* arg) {
     long id = (long) arg;
 
     do_push(id, -1);
 
     do_barrier(id, "PUSH & POP");
+
+    start_measure();
+    do_barrier(id, "DRAIN");
+
+    do_push(id, -1);
+
+    do_barrier(id, "PUSH & POP WAIT");
+
+    do_push_batch(id);
+
+    do_barrier(id, "PUSH BATCH & POP BATCH");
+
+    do_ring_push(id);
+
+    do_barrier(id, "RING PUSH & POP");
+
+    do_sharded_push(id, sq);
+
+    do_barrier(id, "SHARDED PUSH & POP");
+
+    do_sharded_push(id, sqk);
+
+    do_barrier(id, "SHARDED RELAXED PUSH & POP");
+
+    do_bound_push(id);
+
+    do_barrier(id, "SHARDED BOUND");
+
+    do_drain(id);
+
+    do_barrier(id, "SHARDED DRAIN");
+
+    do_splits(id);
 }
 
 void* pop_fun(void* arg) {
@@ -136,6 +438,41 @@ void* pop_fun(void* arg) {
     do_pop(id, -1);
 
     do_barrier(id, "PUSH & POP");
+
+    /* drain what the non-blocking pops missed, then wait for the rest */
+    while(!q_pop(q, &v_arr[0], (int) id));
+
+    do_barrier(id, "DRAIN");
+
+    do_pop_wait(id);
+
+    do_barrier(id, "PUSH & POP WAIT");
+
+    do_pop_batch(id);
+
+    do_barrier(id, "PUSH BATCH & POP BATCH");
+
+    do_ring_pop(id);
+
+    do_barrier(id, "RING PUSH & POP");
+
+    do_sharded_pop(id, sq);
+
+    do_barrier(id, "SHARDED PUSH & POP");
+
+    do_sharded_pop(id, sqk);
+
+    do_barrier(id, "SHARDED RELAXED PUSH & POP");
+
+    do_bound_pop(id);
+
+    do_barrier(id, "SHARDED BOUND");
+
+    do_drain(id);
+
+    do_barrier(id, "SHARDED DRAIN");
+
+    do_splits(id);
 }
 
 int main() {
@@ -144,12 +481,26 @@ int main() {
     gen_data();
 
     q = q_create();
+    rq = rq_create(RING_SIZE);
+    sq = sq_create(NUM_THREAD / 2, 0);
+    sqk = sq_create(NUM_THREAD / 2, SQ_RELAX);
+    sqb = sq_create(NUM_THREAD / 2, SQ_RELAX);
+    /* the tightest bound leaves a pop the fewest lanes to try */
+    sqd = sq_create(NUM_THREAD / 2, 1);
     
     pthread_barrier_init(&barrier, NULL, NUM_THREAD);
 
     for (i = 0; i < NUM_THREAD / 2; i++) {
         ebr_thread_register(q->ebr, i);
         ebr_thread_register(q->ebr, NUM_THREAD / 2 + i);
+        sq_thread_register(sq, i);
+        sq_thread_register(sq, NUM_THREAD / 2 + i);
+        sq_thread_register(sqk, i);
+        sq_thread_register(sqk, NUM_THREAD / 2 + i);
+        sq_thread_register(sqb, i);
+        sq_thread_register(sqb, NUM_THREAD / 2 + i);
+        sq_thread_register(sqd, i);
+        sq_thread_register(sqd, NUM_THREAD / 2 + i);
         pthread_create(&tids[i], NULL, push_fun, (void*) i);
         pthread_create(&tids[NUM_THREAD / 2 + i], NULL, pop_fun, (void*) (NUM_THREAD / 2 + i));
     }
@@ -157,9 +508,38 @@ int main() {
     for (i = 0; i < NUM_THREAD; i++) {
         pthread_join(tids[i], NULL);
         ebr_thread_unregister(q->ebr, i);
+        sq_thread_unregister(sq, i);
+        sq_thread_unregister(sqk, i);
+        sq_thread_unregister(sqb, i);
+        sq_thread_unregister(sqd, i);
+    }
+
+    /* the blocking ops hand over every item exactly once */
+    for (i = 0; i < N / 2; i++) {
+        wait_popped -= v[i];
+        batch_popped -= v[i];
+        split_popped -= NR_SPLITS * v[i];
+        sharded_popped -= 2 * v[i];
+    }
+    test_assert(wait_popped == 0);
+    test_assert(batch_popped == 0);
+    test_assert(split_popped == 0);
+    test_assert(sharded_popped == 0);
+    for (i = 0; i < SQ_DRAIN_ROUNDS * (NUM_THREAD / 2); i++) {
+        drain_popped -= 2 * SQ_DRAIN_ITEMS * v[i];
     }
+    test_assert(drain_popped == 0);
+    test_assert(sq_pop(sqd, &v[0], 0) == -ENOENT);
+    test_assert(ring_pushed == ring_popped);
+    test_assert(rq_try_pop(rq, &v[0]) == -ENOENT);
+    sharded_bound();
 
     q_destroy(q);
+    rq_destroy(rq);
+    sq_destroy(sq);
+    sq_destroy(sqk);
+    sq_destroy(sqb);
+    sq_destroy(sqd);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "atomic.h"
+#include "queue.h"
+
+struct queue* q_create() {
+    struct queue* q = (struct queue*) aligned_alloc(CACHELINE_SIZE, sizeof(struct queue));
+
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+
+    return q;
+}
+
+/*
+ * the queue has to be empty. it can't tell a q_push() node from one the
+ * caller owns, so it neither frees nor hands back what is left.
+ */
+void q_destroy(struct queue* q) {
+    assert(q->tail == &q->stub && q->head == &q->stub);
+    free(q);
+}
+
+void q_push_node(struct queue* q, struct q_node* node) {
+    struct q_node* prev;
+
+    node->next = NULL;
+    prev = xchg(&q->head, node);
+    /* the chain is broken from here until the link below */
+    ACCESS_ONCE(prev->next) = node;
+}
+
+/* popper only */
+struct q_node* q_pop_node(struct queue* q) {
+    struct q_node *tail = q->tail, *next = ACCESS_ONCE(tail->next);
+
+    if (tail == &q->stub) {
+        if (!next) {
+            return NULL;
+        }
+        q->tail = next;
+        tail = next;
+        next = ACCESS_ONCE(next->next);
+    }
+
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    /* tail is the last node or a pusher is linking behind it */
+    if (tail != ACCESS_ONCE(q->head)) {
+        return NULL;
+    }
+
+    /* keep a node in the queue so tail can be handed out */
+    q_push_node(q, &q->stub);
+    next = ACCESS_ONCE(tail->next);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+void q_push(struct queue* q, uval_t v) {
+    struct q_node* node = (struct q_node*) malloc(sizeof(struct q_node));
+
+    node->v = v;
+    q_push_node(q, node);
+}
+
+/* popper only */
+int q_pop(struct queue* q, uval_t* v) {
+    struct q_node* node = q_pop_node(q);
+
+    if (!node) {
+        return -ENOENT;
+    }
+    *v = node->v;
+    free(node);
+
+    return 0;
+}
+
+/* popper only */
+int q_front(struct queue* q, uval_t* v) {
+    struct q_node* node = q->tail;
+
+    if (node == &q->stub) {
+        node = ACCESS_ONCE(node->next);
+        if (!node) {
+            return -ENOENT;
+        }
+    }
+    *v = node->v;
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "atomic.h"
+#include "util.h"
+
+/*
+ * intrusive queue for many pushers and one popper (Vyukov). a push is one
+ * xchg on head, a pop touches no shared counter at all. a pusher stalled
+ * between its xchg and its link hides everything behind it until it goes
+ * on, so q_pop() may miss items that are already in.
+ */
+struct q_node {
+    struct q_node* next;
+    uval_t v;
+};
+
+struct queue {
+    /* pushers */
+    struct q_node* head __attribute__((aligned(CACHELINE_SIZE)));
+
+    /* popper */
+    struct q_node* tail __attribute__((aligned(CACHELINE_SIZE)));
+    struct q_node stub;
+};
+
+extern struct queue* q_create();
+/* only an empty queue may be destroyed */
+extern void q_destroy(struct queue* q);
+
+/* the caller owns the node, a popped node is not touched by the queue anymore */
+extern void q_push_node(struct queue* q, struct q_node* node);
+extern struct q_node* q_pop_node(struct queue* q);
+
+/* node allocating wrappers */
+extern void q_push(struct queue* q, uval_t v);
+extern int q_pop(struct queue* q, uval_t* v);
+extern int q_front(struct queue* q, uval_t* v);
+
+#endif
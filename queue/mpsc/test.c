@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+
+#ifdef __APPLE__
+#include "pthread_barrier.h"
+#endif
+#include "queue.h"
+
+#define N           10000000
+#define NUM_THREAD  8
+
+#define RAND
+// #define DETAIL
+#define ASSERT
+
+#ifdef DETAIL
+#define test_print(fmt, args ...) do{printf(fmt, ##args);}while(0)
+#else
+#define test_print(fmt, args ...) do{}while(0)
+#endif
+
+#ifdef ASSERT
+#define test_assert(arg) do{assert(arg);}while(0)
+#else
+#define test_assert(arg) do{}while(0)
+#endif
+
+__thread struct timeval t0, t1;
+
+pthread_barrier_t barrier;
+pthread_t tids[NUM_THREAD];
+
+ukey_t k[N];
+uval_t v[N];
+
+struct queue* q;
+
+static void gen_data() {
+    int i;
+
+    for (i = 0; i < N; i++) {
+        k[i] = i + 1;
+        v[i] = i + 1;
+    }
+
+#ifdef RAND
+    ukey_t temp_k;
+    uval_t temp_v;
+    int idx;
+
+    srand(time(0));
+    for (i = 0; i < N; i++) {
+        idx = rand() % N;
+        temp_k = k[i];
+        k[i] = k[idx];
+        k[idx] = temp_k;
+        temp_v = v[i];
+        v[i] = v[idx];
+        v[idx] = temp_v;
+    }
+#endif
+}
+
+static void start_measure() {
+    gettimeofday(&t0, NULL);
+}
+
+static double end_measure() {
+    gettimeofday(&t1, NULL);
+    return t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) / 1e6;
+}
+
+static void do_barrier(long id, const char* arg) {
+    pthread_barrier_wait(&barrier);
+    if (id == 0) {
+        printf("%s finished in %.3lf seconds\n", arg, end_measure());
+    }
+}
+
+/* the first NUM_THREAD - 1 threads push slices of indices, the last one pops */
+static int slice_begin(long id) {
+    return 1.0 * id / (NUM_THREAD - 1) * N;
+}
+
+static void do_push(long id) {
+    int st, ed, i;
+    double interval;
+
+    start_measure();
+
+    st = slice_begin(id);
+    ed = slice_begin(id + 1);
+
+    for (i = st; i < ed; i++) {
+        q_push(q, i + 1);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+/* every pusher's items come out in its order */
+static void do_pop(long id) {
+    long last[NUM_THREAD - 1];
+    int i, p;
+    double interval;
+    uval_t v0;
+
+    start_measure();
+
+    for (p = 0; p < NUM_THREAD - 1; p++) {
+        last[p] = slice_begin(p) - 1;
+    }
+
+    for (i = 0; i < N; i++) {
+        while(q_pop(q, &v0)) {
+            sched_yield();
+        }
+        v0--;
+        for (p = 0; v0 >= slice_begin(p + 1); p++);
+        test_assert((long) v0 > last[p]);
+        last[p] = v0;
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+void* push_fun(void* arg) {
+    long id = (long) arg;
+
+    do_push(id);
+
+    do_barrier(id, "PUSH & POP");
+
+    return NULL;
+}
+
+void* pop_fun(void* arg) {
+    long id = (long) arg;
+
+    do_pop(id);
+
+    do_barrier(id, "PUSH & POP");
+
+    return NULL;
+}
+
+int main() {
+    long i;
+    uval_t v0;
+
+    gen_data();
+
+    q = q_create();
+
+    pthread_barrier_init(&barrier, NULL, NUM_THREAD);
+
+    for (i = 0; i < NUM_THREAD - 1; i++) {
+        pthread_create(&tids[i], NULL, push_fun, (void*) i);
+    }
+    pthread_create(&tids[NUM_THREAD - 1], NULL, pop_fun, (void*) (NUM_THREAD - 1));
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    test_assert(q_front(q, &v0) == -ENOENT);
+
+    q_destroy(q);
+
+    return 0;
+}
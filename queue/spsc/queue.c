@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "atomic.h"
+#include "queue.h"
+
+/* size is rounded up to a power of two */
+struct queue* q_create(unsigned int size) {
+    struct queue* q = (struct queue*) aligned_alloc(CACHELINE_SIZE, sizeof(struct queue));
+    unsigned long cap = 1;
+
+    while(cap < size) {
+        cap <<= 1;
+    }
+
+    q->buffer = (uval_t*) malloc(cap * sizeof(uval_t));
+    q->mask = cap - 1;
+    q->head = 0;
+    q->tail_cache = 0;
+    q->tail = 0;
+    q->head_cache = 0;
+
+    return q;
+}
+
+void q_destroy(struct queue* q) {
+    free(q->buffer);
+    free(q);
+}
+
+/* pusher only */
+int q_push(struct queue* q, uval_t v) {
+    unsigned long tail = q->tail;
+
+    if (tail - q->head_cache > q->mask) {
+        q->head_cache = ACCESS_ONCE(q->head);
+        if (tail - q->head_cache > q->mask) {
+            return -ENOBUFS;
+        }
+    }
+
+    q->buffer[tail & q->mask] = v;
+    /* x86 keeps stores in order, the item is visible before the new tail */
+    barrier();
+    ACCESS_ONCE(q->tail) = tail + 1;
+
+    return 0;
+}
+
+/* popper only */
+int q_pop(struct queue* q, uval_t* v) {
+    unsigned long head = q->head;
+
+    if (head == q->tail_cache) {
+        q->tail_cache = ACCESS_ONCE(q->tail);
+        if (head == q->tail_cache) {
+            return -ENOENT;
+        }
+    }
+
+    *v = q->buffer[head & q->mask];
+    /* the slot is read before the pusher may reuse it */
+    barrier();
+    ACCESS_ONCE(q->head) = head + 1;
+
+    return 0;
+}
+
+/* popper only */
+int q_front(struct queue* q, uval_t* v) {
+    unsigned long head = q->head;
+
+    if (head == q->tail_cache) {
+        q->tail_cache = ACCESS_ONCE(q->tail);
+        if (head == q->tail_cache) {
+            return -ENOENT;
+        }
+    }
+
+    *v = q->buffer[head & q->mask];
+
+    return 0;
+}
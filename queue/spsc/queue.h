@@ -0,0 +1,34 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "atomic.h"
+#include "util.h"
+
+/*
+ * wait-free ring for exactly one pusher and one popper. each side keeps
+ * a private copy of the other side's index and only reads the shared
+ * one when the copy says full or empty.
+ */
+struct queue {
+    uval_t* buffer;
+    unsigned long mask;
+
+    /* popper */
+    unsigned long head __attribute__((aligned(CACHELINE_SIZE)));
+    unsigned long tail_cache;
+
+    /* pusher */
+    unsigned long tail __attribute__((aligned(CACHELINE_SIZE)));
+    unsigned long head_cache;
+};
+
+extern struct queue* q_create(unsigned int size);
+extern void q_destroy(struct queue* q);
+extern int q_push(struct queue* q, uval_t v);
+extern int q_pop(struct queue* q, uval_t* v);
+extern int q_front(struct queue* q, uval_t* v);
+
+#endif
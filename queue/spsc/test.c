@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+
+#ifdef __APPLE__
+#include "pthread_barrier.h"
+#endif
+#include "queue.h"
+
+#define N           10000000
+#define NUM_THREAD  2
+
+#define POOL_SIZE   (1 << 16)
+
+#define RAND
+// #define DETAIL
+#define ASSERT
+
+#ifdef DETAIL
+#define test_print(fmt, args ...) do{printf(fmt, ##args);}while(0)
+#else
+#define test_print(fmt, args ...) do{}while(0)
+#endif
+
+#ifdef ASSERT
+#define test_assert(arg) do{assert(arg);}while(0)
+#else
+#define test_assert(arg) do{}while(0)
+#endif
+
+__thread struct timeval t0, t1;
+
+pthread_barrier_t barrier;
+pthread_t tids[NUM_THREAD];
+
+ukey_t k[N];
+uval_t v[N];
+
+struct queue* q;
+
+static void gen_data() {
+    int i;
+
+    for (i = 0; i < N; i++) {
+        k[i] = i + 1;
+        v[i] = i + 1;
+    }
+
+#ifdef RAND
+    ukey_t temp_k;
+    uval_t temp_v;
+    int idx;
+
+    srand(time(0));
+    for (i = 0; i < N; i++) {
+        idx = rand() % N;
+        temp_k = k[i];
+        k[i] = k[idx];
+        k[idx] = temp_k;
+        temp_v = v[i];
+        v[i] = v[idx];
+        v[idx] = temp_v;
+    }
+#endif
+}
+
+static void start_measure() {
+    gettimeofday(&t0, NULL);
+}
+
+static double end_measure() {
+    gettimeofday(&t1, NULL);
+    return t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) / 1e6;
+}
+
+static void do_barrier(long id, const char* arg) {
+    pthread_barrier_wait(&barrier);
+    if (id == 0) {
+        printf("%s finished in %.3lf seconds\n", arg, end_measure());
+    }
+}
+
+/* one pusher and one popper, the popper must see v[] in order */
+static void do_push(long id) {
+    int i;
+    double interval;
+
+    start_measure();
+
+    for (i = 0; i < N; i++) {
+        while(q_push(q, v[i])) {
+            sched_yield();
+        }
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+static void do_pop(long id) {
+    int i;
+    double interval;
+    uval_t v0;
+
+    start_measure();
+
+    for (i = 0; i < N; i++) {
+        while(q_pop(q, &v0)) {
+            sched_yield();
+        }
+        test_assert(v0 == v[i]);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", id, interval);
+}
+
+void* push_fun(void* arg) {
+    long id = (long) arg;
+
+    do_push(id);
+
+    do_barrier(id, "PUSH & POP");
+
+    return NULL;
+}
+
+void* pop_fun(void* arg) {
+    long id = (long) arg;
+
+    do_pop(id);
+
+    do_barrier(id, "PUSH & POP");
+
+    return NULL;
+}
+
+int main() {
+    uval_t v0;
+
+    gen_data();
+
+    q = q_create(POOL_SIZE);
+
+    pthread_barrier_init(&barrier, NULL, NUM_THREAD);
+
+    pthread_create(&tids[0], NULL, push_fun, (void*) 0);
+    pthread_create(&tids[1], NULL, pop_fun, (void*) 1);
+
+    pthread_join(tids[0], NULL);
+    pthread_join(tids[1], NULL);
+
+    test_assert(q_front(q, &v0) == -ENOENT);
+
+    q_destroy(q);
+
+    return 0;
+}
@@ -1,12 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sched.h>
 
 #include "ebr.h"
 
 #define ACTIVE  0x4
 #define GC_FRQ  100
 
+#ifdef EBR_PREEMPT
+/* test builds: the epoch moves on between reading and publishing it */
+#define ebr_preempt()       sched_yield()
+#else
+#define ebr_preempt()
+#endif
+
 extern struct ebr* ebr_create(free_fun_t _free) {
     struct ebr* ebr = (struct ebr*) malloc(sizeof(struct ebr));
     int i;
@@ -52,15 +60,24 @@ extern void ebr_thread_unregister(struct ebr* ebr, int tid) {
 }
 
 extern void ebr_enter(struct ebr* ebr, int tid) {
-    unsigned int epoch = ACCESS_ONCE(ebr->global_epoch);
+    unsigned int epoch;
 
-    ebr->e_nodes[tid].local_epoch = epoch | ACTIVE;
-    memory_mfence();
+    /* the epoch may move on before we show up, retry until we pin it */
+    do {
+        epoch = ACCESS_ONCE(ebr->global_epoch);
+        ebr_preempt();
+        ebr->e_nodes[tid].local_epoch = epoch | ACTIVE;
+        memory_mfence();
+    } while(epoch != ACCESS_ONCE(ebr->global_epoch));
 }
 
+/*
+ * leaving only needs release order, which x86 stores already have, the
+ * fence in ebr_enter() is the one that keeps reclaimers from missing us
+ */
 extern void ebr_exit(struct ebr* ebr, int tid) {
+    barrier();
     ebr->e_nodes[tid].local_epoch = 0;
-    memory_mfence();
 }
 
 extern void ebr_put(struct ebr* ebr, void* addr, int tid) {
@@ -98,8 +115,8 @@ extern void ebr_try_gc(struct ebr* ebr) {
         }
         local_epoch = ACCESS_ONCE(ebr->e_nodes[i].local_epoch);
         active = (local_epoch & ACTIVE) == ACTIVE;
+        /* a thread in epoch - 1 may still hold what epoch - 2 retired */
         if (active && local_epoch != (epoch | ACTIVE)) {
-            gc_epoch(ebr, (epoch + 1) % 3);
             pthread_mutex_unlock(&ebr->lock);
             return;
         }
@@ -108,7 +125,11 @@ extern void ebr_try_gc(struct ebr* ebr) {
     ebr->global_epoch = (epoch + 1) % 3;
     memory_mfence();
 
-    gc_epoch(ebr, (epoch + 2) % 3);
+    /*
+     * everybody is in epoch now. what epoch - 1 retired may still be seen
+     * by them, epoch - 2 is the newest list nobody can reach
+     */
+    gc_epoch(ebr, (epoch + 1) % 3);
     
     pthread_mutex_unlock(&ebr->lock);
 }
@@ -227,6 +227,89 @@ void ebr_test() {
     printf("EBR PASSED, time elapsed %.3lf seconds\n", interval);
 }
 
+/* keep trying until the gc moves the global epoch on */
+static void ebr_advance(struct ebr* ebr) {
+    unsigned int epoch = ACCESS_ONCE(ebr->global_epoch);
+
+    while(ACCESS_ONCE(ebr->global_epoch) == epoch) {
+        ebr_try_gc(ebr);
+    }
+}
+
+/*
+ * thread 1 retires an item from one epoch behind thread 0, which may still
+ * hold it. the advance past thread 0's epoch must not free it
+ */
+void ebr_order_test() {
+    printf("EBR ORDER TEST START\n");
+
+    gen_workload();
+    ebr = ebr_create(set_free);
+    ebr_thread_register(ebr, 0);
+    ebr_thread_register(ebr, 1);
+
+    ebr_enter(ebr, 1);
+    ebr_advance(ebr);
+    ebr_enter(ebr, 0);
+    access_item(&items[0]);
+
+    assert(logical_del(&items[0]));
+    ebr_put(ebr, &items[0], 1);
+    ebr_exit(ebr, 1);
+
+    ebr_advance(ebr);
+    access_item(&items[0]);
+    ebr_exit(ebr, 0);
+
+    /* nobody can reach it two epochs on */
+    ebr_advance(ebr);
+    ebr_advance(ebr);
+    assert(items[0].free);
+
+    ebr_destroy(ebr);
+    printf("EBR ORDER PASSED\n");
+}
+
+int enter_stop;
+
+void* ebr_gc_fun(void* args) {
+    while(!ACCESS_ONCE(enter_stop)) {
+        ebr_try_gc(ebr);
+    }
+    return NULL;
+}
+
+/* another thread keeps moving the epoch on while thread 0 enters */
+void ebr_enter_test() {
+    pthread_t gc_tid;
+    unsigned int local, global;
+    int times = REPEAT_TIMES / 10;
+
+    printf("EBR ENTER TEST START\n");
+
+    start_measure();
+    ebr = ebr_create(set_free);
+    ebr_thread_register(ebr, 0);
+    enter_stop = 0;
+    pthread_create(&gc_tid, NULL, ebr_gc_fun, NULL);
+
+    while(times--) {
+        ebr_enter(ebr, 0);
+        /* the ACTIVE bit sits above the epoch */
+        local = ACCESS_ONCE(ebr->e_nodes[0].local_epoch) & 0x3;
+        global = ACCESS_ONCE(ebr->global_epoch);
+        /* once in, we hold the epoch back, it gets at most one ahead */
+        assert(global == local || global == (local + 1) % 3);
+        ebr_exit(ebr, 0);
+    }
+
+    enter_stop = 1;
+    pthread_join(gc_tid, NULL);
+    ebr_destroy(ebr);
+    interval = end_measure();
+    printf("EBR ENTER PASSED, time elapsed %.3lf seconds\n", interval);
+}
+
 void qsbr_test() {
     int times = REPEAT_TIMES;
 
@@ -266,6 +349,8 @@ void hpbr_test() {
 
 int main() {
     ebr_test();
+    ebr_order_test();
+    ebr_enter_test();
     qsbr_test();
     hpbr_test();
 }
\ No newline at end of file
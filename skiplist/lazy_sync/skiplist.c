@@ -10,10 +10,16 @@
 #include "atomic.h"
 #include "skiplist.h"
 
-static struct sl_node* alloc_node(int levels, ukey_t k, uval_t v) {
-    unsigned int size = sizeof(struct sl_node) + levels * sizeof(markable_t);
-    struct sl_node* node = aligned_alloc(8, size);
+#ifdef SL_RTM
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
+static unsigned int node_size(int levels) {
+    return sizeof(struct sl_node) + levels * sizeof(markable_t);
+}
+
+static struct sl_node* init_node(struct sl_node* node, int levels, ukey_t k, uval_t v) {
     node->e.k = k;
     node->e.v = v;
     node->levels = levels;
@@ -23,22 +29,52 @@ static struct sl_node* alloc_node(int levels, ukey_t k, uval_t v) {
     return node;
 }
 
-static void free_node(struct sl_node* node) {
-    free(node);
+/* nodes of the same height share a slab */
+static struct sl_node* alloc_node(struct sl* sl, int levels, ukey_t k, uval_t v, int tid) {
+    return init_node(slab_alloc(sl->slabs[levels - 1], tid), levels, k, v);
+}
+
+static void free_node(struct sl_node* node, int tid) {
+    slab_free(node, tid);
+}
+
+/* ebr frees in its own gc pass, no thread id goes with it */
+static void reclaim_node(struct sl_node* node) {
+    free_node(node, -1);
 }
 
+#ifdef SL_RTM
+/* CPUID.(EAX=7, ECX=0):EBX bit 11 */
+static int has_rtm() {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+
+    return (ebx >> 11) & 1;
+}
+#endif
+
 struct sl* sl_create(int max_levels) {
     assert(max_levels > 0);
     srand(time(0));
 
-    struct sl* sl = (struct sl*) malloc(sizeof(struct sl));
+    struct sl* sl = (struct sl*) aligned_alloc(__alignof__(struct sl), sizeof(struct sl));
     int i;
 
     sl->max_levels = max_levels;
     sl->levels = 1;
+    memset(sl->retries, 0, sizeof(sl->retries));
 
-    sl->head = alloc_node(max_levels, 0, 0);
-    sl->tail = alloc_node(max_levels, UINT64_MAX, 0);
+    sl->slabs = (struct slab**) malloc(max_levels * sizeof(struct slab*));
+    for (i = 0; i < max_levels; i++) {
+        sl->slabs[i] = slab_create(node_size(i + 1));
+    }
+
+    /* head and tail carry full towers, keep them out of the slabs */
+    sl->head = init_node(aligned_alloc(8, node_size(max_levels)), max_levels, 0, 0);
+    sl->tail = init_node(aligned_alloc(8, node_size(max_levels)), max_levels, UINT64_MAX, 0);
 
     for (i = 0; i < max_levels; i++) {
         sl->head->next[i] = (markable_t) sl->tail;
@@ -47,23 +83,29 @@ struct sl* sl_create(int max_levels) {
     GET_SIGN(sl->head) = FULLY_LINK(sl->head);
     GET_SIGN(sl->tail) = FULLY_LINK(sl->tail);
 
-    sl->ebr = ebr_create((free_fun_t) free_node);
+    sl->ebr = ebr_create((free_fun_t) reclaim_node);
+
+#ifdef SL_RTM
+    sl->rtm = has_rtm();
+#endif
 
     return sl;
 }
 
 void sl_destroy(struct sl* sl) {
-    struct sl_node *pred, *curr;
-    
-    pred = sl->head;
-    while(pred) {
-        curr = GET_NODE(pred->next[0]);
-        free_node(pred);
-        pred = curr;
-    }
+    int i;
 
+    /* retired nodes go back to the slabs first */
     ebr_destroy(sl->ebr);
 
+    for (i = 0; i < sl->max_levels; i++) {
+        slab_destroy(sl->slabs[i]);
+    }
+    free(sl->slabs);
+
+    free(sl->head);
+    free(sl->tail);
+
     free(sl);
 }
 
@@ -78,17 +120,25 @@ static int find(struct sl* sl, ukey_t k, struct sl_node** preds, struct sl_node*
         while(k_cmp(curr->e.k, k) < 0) {
             pred = curr;
             curr = GET_NODE(pred->next[i]);
+            prefetch_r(GET_NODE(curr->next[i]));
         }
         if (k_cmp(curr->e.k, k) == 0 && found_level == -1) {
             found_level = i;
         }
         preds[i] = pred;
         succs[i] = curr;
+        if (i > 0) {
+            prefetch_r(GET_NODE(pred->next[i - 1]));
+        }
     }
 
     return found_level;
 }
 
+static int is_valid(struct sl_node* node) {
+    return IS_FULLY_LINKED(node) && !IS_MARKED(node);
+}
+
 static int get_rand_levels(struct sl* sl) {
     int levels = 1, old;
 
@@ -109,58 +159,149 @@ static int get_rand_levels(struct sl* sl) {
     return levels;
 }
 
+/*
+ * preds[] never go right when climbing up, so equal preds are neighbours
+ * and each distinct pred is locked once. returns 0 if a pred turns out
+ * to be stale, *locked_level tells unlock_preds() how far we got.
+ */
+static int lock_preds(struct sl_node** preds, struct sl_node** succs, int levels,
+                      struct sl_node* victim, int* locked_level) {
+    struct sl_node *pred, *succ;
+    int i;
+
+    *locked_level = -1;
+    for (i = 0; i < levels; i++) {
+        pred = preds[i];
+        succ = succs[i];
+        if (i == 0 || preds[i - 1] != pred) {
+            spin_lock(&pred->lock);
+        }
+        *locked_level = i;
+        if (IS_MARKED(pred) || GET_NODE(pred->next[i]) != succ ||
+            (succ != victim && IS_MARKED(succ))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void unlock_preds(struct sl_node** preds, int locked_level) {
+    int i;
+
+    for (i = 0; i <= locked_level; i++) {
+        if (i == 0 || preds[i - 1] != preds[i]) {
+            spin_unlock(&preds[i]->lock);
+        }
+    }
+}
+
+#ifdef SL_RTM
+/*
+ * lock elision: validate and link in one transaction. a pred lock is read
+ * inside it, so a locked pred or a later locker aborts us, and the caller
+ * falls back to lock_preds().
+ */
+static int rtm_insert(struct sl_node** preds, struct sl_node** succs, struct sl_node* node) {
+    int i;
+
+    for (i = 0; i < node->levels; i++) {
+        node->next[i] = (markable_t) succs[i];
+    }
+
+    if (_xbegin() != _XBEGIN_STARTED) {
+        return 0;
+    }
+
+    for (i = 0; i < node->levels; i++) {
+        if (spin_is_locked(&preds[i]->lock) || IS_MARKED(preds[i]) ||
+            IS_MARKED(succs[i]) || GET_NODE(preds[i]->next[i]) != succs[i]) {
+            _xabort(0xff);
+        }
+    }
+
+    preds[0]->next[0] = FULLY_LINK2(node);
+    for (i = 1; i < node->levels; i++) {
+        preds[i]->next[i] = (markable_t) node;
+    }
+    GET_SIGN(node) = FULLY_LINK(node);
+
+    _xend();
+
+    return 1;
+}
+
+static int rtm_remove(struct sl_node** preds, struct sl_node* node) {
+    int i;
+
+    if (_xbegin() != _XBEGIN_STARTED) {
+        return 0;
+    }
+
+    if (spin_is_locked(&node->lock) || IS_MARKED(node) || !IS_FULLY_LINKED(node)) {
+        _xabort(0xff);
+    }
+    for (i = 0; i < node->levels; i++) {
+        if (spin_is_locked(&preds[i]->lock) || IS_MARKED(preds[i]) ||
+            GET_NODE(preds[i]->next[i]) != node) {
+            _xabort(0xff);
+        }
+    }
+
+    GET_SIGN(node) = MARK_NODE(node);
+    preds[0]->next[0] = FULLY_LINK2(GET_NODE(node->next[0]));
+    for (i = 1; i < node->levels; i++) {
+        preds[i]->next[i] = node->next[i];
+    }
+
+    _xend();
+
+    return 1;
+}
+#endif
+
 int sl_insert(struct sl* sl, ukey_t k, uval_t v, int tid) {
     const int max_levels = sl->max_levels;
     struct sl_node* preds[max_levels];
     struct sl_node* succs[max_levels];
-    struct sl_node *pred, *succ, *node;
-    int found_level, locked_level, all_locked;
+    struct sl_node* node;
+    int found_level, locked_level;
     int node_levels;
     int i;
 
     ebr_enter(sl->ebr, tid);
 
     node_levels = get_rand_levels(sl);
+    node = alloc_node(sl, node_levels, k, v, tid);
 
 retry:
     found_level = find(sl, k, preds, succs);
     if (found_level != -1) {
         if (IS_MARKED(succs[found_level])) {
+            sl->retries[tid].n++;
             goto retry;
         } else {
             while(!IS_FULLY_LINKED(succs[found_level]));
+            /* never published */
+            free_node(node, tid);
             ebr_exit(sl->ebr, tid);
             return -EEXIST;
         }
     }
 
-    locked_level = -1;
-    all_locked = 1;
-    for (i = 0; i < node_levels; i++) {
-        pred = preds[i];
-        succ = succs[i];
-        if (i == 0 || preds[i - 1] != pred) {
-            spin_lock(&pred->lock);
-        }
-        locked_level = i;
-        if (IS_MARKED(pred) || IS_MARKED(succ) || GET_NODE(pred->next[i]) != succ) {
-            all_locked = 0;
-            break;
-        }
+#ifdef SL_RTM
+    if (sl->rtm && rtm_insert(preds, succs, node)) {
+        ebr_exit(sl->ebr, tid);
+        return 0;
     }
-    
-    if (!all_locked) {
-        for (i = 0; i <= locked_level; i++) {
-            pred = preds[i];
-            if (i == 0 || preds[i - 1] != pred) {
-                spin_unlock(&pred->lock);
-            }
-        }
+#endif
+
+    if (!lock_preds(preds, succs, node_levels, NULL, &locked_level)) {
+        unlock_preds(preds, locked_level);
+        sl->retries[tid].n++;
         goto retry;
     }
 
-    node = alloc_node(node_levels, k, v);
-    
     node->next[0] = (markable_t) succs[0];
     preds[0]->next[0] = FULLY_LINK2(node);
     for (i = 1; i < node_levels; i++) {
@@ -169,114 +310,284 @@ retry:
     }
     GET_SIGN(node) = FULLY_LINK(node);
 
-    for (i = 0; i <= locked_level; i++) {
-        pred = preds[i];
-        if (i == 0 || preds[i - 1] != pred) {
-            spin_unlock(&pred->lock);
-        }
-    }
+    unlock_preds(preds, locked_level);
 
     ebr_exit(sl->ebr, tid);
 
     return 0;
 }
 
+/* wait-free: a single descent that takes no lock and never restarts */
 int sl_lookup(struct sl* sl, ukey_t k, uval_t* v, int tid) {
+    struct sl_node *pred, *curr;
+    int i, ret = -ENOENT;
+
+    ebr_enter(sl->ebr, tid);
+
+    *v = 0;
+    pred = sl->head;
+    for (i = ACCESS_ONCE(sl->levels) - 1; i >= 0; i--) {
+        curr = GET_NODE(pred->next[i]);
+        while(k_cmp(curr->e.k, k) < 0) {
+            pred = curr;
+            curr = GET_NODE(pred->next[i]);
+            prefetch_r(GET_NODE(curr->next[i]));
+        }
+        if (k_cmp(curr->e.k, k) == 0) {
+            if (is_valid(curr)) {
+                *v = curr->e.v;
+                ret = 0;
+            }
+            break;
+        }
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+struct lookup_state {
+    struct sl_node *pred, *curr;
+    int level;
+    unsigned int idx;
+};
+
+/* interleave SL_BATCH_WIDTH searches, a hop of one search hides the cache miss of the others */
+int sl_lookup_batch(struct sl* sl, ukey_t* k_arr, unsigned int len, uval_t* v_arr, int* ret_arr, int tid) {
+    struct lookup_state states[SL_BATCH_WIDTH];
+    struct lookup_state* st;
+    unsigned int next = 0;
+    int active = 0, found = 0;
+    int i;
+
+    ebr_enter(sl->ebr, tid);
+
+    for (i = 0; i < SL_BATCH_WIDTH && next < len; i++) {
+        st = &states[active++];
+        st->idx = next++;
+        st->level = sl->max_levels - 1;
+        st->pred = sl->head;
+        st->curr = GET_NODE(sl->head->next[st->level]);
+        prefetch_r(st->curr);
+    }
+
+    while(active) {
+        for (i = 0; i < active; i++) {
+            st = &states[i];
+            if (k_cmp(st->curr->e.k, k_arr[st->idx]) < 0) {
+                st->pred = st->curr;
+                st->curr = GET_NODE(st->curr->next[st->level]);
+            } else if (st->level > 0) {
+                st->level--;
+                st->curr = GET_NODE(st->pred->next[st->level]);
+            } else {
+                /* this search is done, start a new one in its place */
+                if (k_cmp(st->curr->e.k, k_arr[st->idx]) == 0 && is_valid(st->curr)) {
+                    v_arr[st->idx] = st->curr->e.v;
+                    ret_arr[st->idx] = 0;
+                    found++;
+                } else {
+                    v_arr[st->idx] = 0;
+                    ret_arr[st->idx] = -ENOENT;
+                }
+                if (next < len) {
+                    st->idx = next++;
+                    st->level = sl->max_levels - 1;
+                    st->pred = sl->head;
+                    st->curr = GET_NODE(sl->head->next[st->level]);
+                } else {
+                    states[i--] = states[--active];
+                    continue;
+                }
+            }
+            prefetch_r(st->curr);
+        }
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return found;
+}
+
+/*
+ * lock and mark a live node, fails if another remover got it first.
+ * poppers all go for the same few nodes, so they poll instead of queueing
+ * behind each other on the ticket lock.
+ */
+static int lock_victim(struct sl_node* node) {
+    while(!spin_trylock(&node->lock)) {
+        if (IS_MARKED(node)) {
+            return 0;
+        }
+        cpu_relax();
+    }
+    if (IS_MARKED(node)) {
+        spin_unlock(&node->lock);
+        return 0;
+    }
+    GET_SIGN(node) = MARK_NODE(node);
+
+    return 1;
+}
+
+/* unlink a node locked by lock_victim(), preds/succs come from a find() of its key */
+static void unlink_node(struct sl* sl, struct sl_node* node, struct sl_node** preds,
+                        struct sl_node** succs, int tid) {
+    int locked_level, i;
+
+    /* the victim stays locked and marked across retries */
+    while(!lock_preds(preds, succs, node->levels, node, &locked_level)) {
+        unlock_preds(preds, locked_level);
+        sl->retries[tid].n++;
+        find(sl, node->e.k, preds, succs);
+    }
+
+    preds[0]->next[0] = FULLY_LINK2(GET_NODE(node->next[0]));
+    for (i = 1; i < node->levels; i++) {
+        preds[i]->next[i] = node->next[i];
+    }
+
+    spin_unlock(&node->lock);
+    unlock_preds(preds, locked_level);
+
+    ebr_put(sl->ebr, node, tid);
+}
+
+int sl_remove(struct sl* sl, ukey_t k, int tid) {
     const int max_levels = sl->max_levels;
     struct sl_node* preds[max_levels];
     struct sl_node* succs[max_levels];
     struct sl_node* node;
     int found_level;
-    
-    found_level = find(sl, k, preds, succs);
-    node = succs[found_level];
 
-    if (found_level != -1 && IS_FULLY_LINKED(node) && !IS_MARKED(node)) {
-        *v = node->e.v;
+    ebr_enter(sl->ebr, tid);
+
+    found_level = find(sl, k, preds, succs);
+    node = found_level != -1 ? succs[found_level] : NULL;
+    if (!(node && IS_FULLY_LINKED(node) && !IS_MARKED(node))) {
+        ebr_exit(sl->ebr, tid);
+        return -ENOENT;
+    }
 
+#ifdef SL_RTM
+    if (sl->rtm && rtm_remove(preds, node)) {
+        ebr_put(sl->ebr, node, tid);
         ebr_exit(sl->ebr, tid);
         return 0;
     }
+#endif
 
-    *v = 0;
+    if (!lock_victim(node)) {
+        ebr_exit(sl->ebr, tid);
+        return -ENOENT;
+    }
+    unlink_node(sl, node, preds, succs, tid);
 
     ebr_exit(sl->ebr, tid);
-    return -ENOENT;
+
+    return 0;
 }
 
-int sl_remove(struct sl* sl, ukey_t k, int tid) {
+/* exact delete-min: remove the first live node on the bottom level */
+int sl_pop_min(struct sl* sl, entry_t* e, int tid) {
     const int max_levels = sl->max_levels;
     struct sl_node* preds[max_levels];
     struct sl_node* succs[max_levels];
-    struct sl_node *pred, *succ, *node;
-    int found_level, locked_level, node_levels;
-    int is_marked = 0, all_locked, i;
+    struct sl_node* node;
 
     ebr_enter(sl->ebr, tid);
 
-retry:
-    found_level = find(sl, k, preds, succs);
-    node = succs[found_level];
-    if (!is_marked && 
-        !(found_level != -1 && IS_FULLY_LINKED(node) && !IS_MARKED(node))) {
-        return -ENOENT;    
+    node = GET_NODE(sl->head->next[0]);
+    while(node != sl->tail) {
+        if (is_valid(node)) {
+            *e = node->e;
+            if (lock_victim(node)) {
+                find(sl, node->e.k, preds, succs);
+                unlink_node(sl, node, preds, succs, tid);
+                ebr_exit(sl->ebr, tid);
+                return 0;
+            }
+        }
+        node = GET_NODE(node->next[0]);
     }
-    if (!is_marked) {
-        spin_lock(&node->lock);
-        if (IS_MARKED(node)) {
-            spin_unlock(&node->lock);
 
-            ebr_exit(sl->ebr, tid);
-            return -ENOENT;
-        }
-        node_levels = node->levels;
-        GET_SIGN(node) = MARK_NODE(node);
-        is_marked = 1;
+    ebr_exit(sl->ebr, tid);
+
+    return -ENOENT;
+}
+
+static __thread unsigned int spray_seed;
+
+/*
+ * SprayList relaxed delete-min, see the lock-free skiplist. the landing
+ * node is removed under its lock instead of with a mark CAS.
+ */
+int sl_spray_pop(struct sl* sl, entry_t* e, int nr_threads, int tid) {
+    const int max_levels = sl->max_levels;
+    struct sl_node* preds[max_levels];
+    struct sl_node* succs[max_levels];
+    struct sl_node *node, *next;
+    int log_p = 0, height, jump, steps;
+    int i, t;
+
+    while((1 << log_p) < nr_threads) {
+        log_p++;
+    }
+    if (log_p == 0) {
+        return sl_pop_min(sl, e, tid);
     }
+    height = ACCESS_ONCE(sl->levels);
+    if (height > log_p) {
+        height = log_p;
+    }
+    jump = log_p * log_p * log_p;
 
-    locked_level = -1;
-    all_locked = 1;
-    for (i = 0; i < node_levels; i++) {
-        pred = preds[i];
-        succ = succs[i];
-        if (i == 0 || preds[i - 1] != pred) {
-            spin_lock(&pred->lock);
-        }
-        locked_level = i;
-        if (IS_MARKED(pred) || GET_NODE(pred->next[i]) != succ) {
-            all_locked = 0;
-            break;
-        }
+    if (!spray_seed) {
+        spray_seed = time(0) ^ (tid + 1);
     }
-    
-    if (!all_locked) {
-        spin_unlock(&node->lock);
-        for (i = 0; i <= locked_level; i++) {
-            pred = preds[i];
-            if (i == 0 || preds[i - 1] != pred) {
-                spin_unlock(&pred->lock);
+
+    ebr_enter(sl->ebr, tid);
+
+    for (t = 0; t < SL_SPRAY_TRIES; t++) {
+        node = sl->head;
+        for (i = height - 1; i >= 0; i--) {
+            steps = rand_r(&spray_seed) % (jump + 1);
+            while(steps) {
+                next = GET_NODE(node->next[i]);
+                if (next == sl->tail) {
+                    break;
+                }
+                node = next;
+                if (is_valid(node)) {
+                    steps--;
+                }
             }
         }
-        goto retry;
-    }
 
-    preds[0]->next[0] = FULLY_LINK2(GET_NODE(node->next[0]));
-    for (i = 1; i < node_levels; i++) {
-        preds[i]->next[i] = node->next[i];
-    }
+        /* take the first live node from the landing spot on */
+        if (node == sl->head) {
+            node = GET_NODE(node->next[0]);
+        }
+        while(node != sl->tail && !is_valid(node)) {
+            node = GET_NODE(node->next[0]);
+        }
+        if (node == sl->tail) {
+            break;
+        }
 
-    spin_unlock(&node->lock);
-    for (i = 0; i <= locked_level; i++) {
-        pred = preds[i];
-        if (i == 0 || preds[i - 1] != pred) {
-            spin_unlock(&pred->lock);
+        *e = node->e;
+        if (lock_victim(node)) {
+            find(sl, node->e.k, preds, succs);
+            unlink_node(sl, node, preds, succs, tid);
+            ebr_exit(sl->ebr, tid);
+            return 0;
         }
     }
 
-    ebr_put(sl->ebr, node, tid);
     ebr_exit(sl->ebr, tid);
 
-    return 0;
+    return sl_pop_min(sl, e, tid);
 }
 
 int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid) {
@@ -303,6 +614,192 @@ int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid)
     return cnt;
 }
 
+/* the last valid node < k, or head */
+static struct sl_node* lower_node(struct sl* sl, ukey_t k) {
+    const int max_levels = sl->max_levels;
+    struct sl_node* preds[max_levels];
+    struct sl_node* succs[max_levels];
+
+    while(1) {
+        find(sl, k, preds, succs);
+        if (preds[0] == sl->head || is_valid(preds[0])) {
+            return preds[0];
+        }
+        /* being inserted or removed, skip it */
+        k = preds[0]->e.k;
+    }
+}
+
+/* the first valid node >= k, or tail */
+static struct sl_node* upper_node(struct sl* sl, ukey_t k) {
+    const int max_levels = sl->max_levels;
+    struct sl_node* preds[max_levels];
+    struct sl_node* succs[max_levels];
+
+    while(1) {
+        find(sl, k, preds, succs);
+        if (succs[0] == sl->tail || is_valid(succs[0])) {
+            return succs[0];
+        }
+        k = succs[0]->e.k + 1;
+    }
+}
+
+int sl_floor(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node* node;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = upper_node(sl, k);
+    if (node == sl->tail || k_cmp(node->e.k, k) != 0) {
+        node = lower_node(sl, k);
+    }
+    if (node != sl->head) {
+        *e = node->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+int sl_ceiling(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node* node;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = upper_node(sl, k);
+    if (node != sl->tail) {
+        *e = node->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+int sl_predecessor(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node* node;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = lower_node(sl, k);
+    if (node != sl->head) {
+        *e = node->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+/* collect at most len entries <= k in descending order */
+/* there are no back links, every step is a predecessor search from the top */
+int sl_range_desc(struct sl* sl, ukey_t k, unsigned int len, entry_t* e_arr, int tid) {
+    struct sl_node* node;
+    unsigned int cnt = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = upper_node(sl, k);
+    if (node == sl->tail || k_cmp(node->e.k, k) != 0) {
+        node = lower_node(sl, k);
+    }
+
+    while(cnt < len && node != sl->head) {
+        e_arr[cnt++] = node->e;
+        node = lower_node(sl, node->e.k);
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return cnt;
+}
+
+void sl_cursor_open(struct sl* sl, struct sl_cursor* cur, ukey_t k, int tid) {
+    cur->sl = sl;
+    cur->tid = tid;
+
+    ebr_enter(sl->ebr, tid);
+
+    cur->node = upper_node(sl, k);
+}
+
+/* copy at most len entries under the cursor and move forward, 0 at the end */
+int sl_cursor_next(struct sl_cursor* cur, entry_t* e_arr, unsigned int len) {
+    struct sl_node* node = cur->node;
+    unsigned int cnt = 0;
+
+    while(cnt < len && node != cur->sl->tail) {
+        if (is_valid(node)) {
+            e_arr[cnt++] = node->e;
+        }
+        node = GET_NODE(node->next[0]);
+    }
+    cur->node = node;
+
+    return cnt;
+}
+
+void sl_cursor_close(struct sl_cursor* cur) {
+    ebr_exit(cur->sl->ebr, cur->tid);
+}
+
+/* call fun on every entry >= k in place until it returns non-zero */
+int sl_scan(struct sl* sl, ukey_t k, scan_fun_t fun, void* arg, int tid) {
+    struct sl_node* node;
+    int cnt = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = upper_node(sl, k);
+    while(node != sl->tail) {
+        if (is_valid(node)) {
+            cnt++;
+            if (fun(node->e.k, node->e.v, arg)) {
+                break;
+            }
+        }
+        node = GET_NODE(node->next[0]);
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return cnt;
+}
+
+/* bytes held by the skiplist */
+size_t sl_mem_usage(struct sl* sl) {
+    size_t size = sizeof(struct sl) + 2 * node_size(sl->max_levels);
+    int i;
+
+    for (i = 0; i < sl->max_levels; i++) {
+        size += slab_mem_usage(sl->slabs[i]);
+    }
+
+    return size;
+}
+
+unsigned long sl_retries(struct sl* sl) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < MAX_NUM_THREADS; i++) {
+        sum += ACCESS_ONCE(sl->retries[i].n);
+    }
+
+    return sum;
+}
+
 void sl_print(struct sl* sl) {
     struct sl_node* node;
     int i;
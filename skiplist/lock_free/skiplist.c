@@ -10,74 +10,114 @@
 #include "atomic.h"
 #include "skiplist.h"
 
-static struct sl_node* alloc_node(int levels, ukey_t k, uval_t v) {
-    unsigned int size = sizeof(struct sl_node) + levels * sizeof(markable_t);
-    struct sl_node* node = aligned_alloc(8, size);
+static unsigned int node_size(int levels) {
+    return sizeof(struct sl_node) + levels * sizeof(markable_t);
+}
+
+/* nodes of the same height share a slab, the height is known from the slab */
+static int get_node_levels(struct sl_node* node) {
+    return (slab_of(node)->obj_size - sizeof(struct sl_node)) / sizeof(markable_t);
+}
 
+static struct sl_node* init_node(struct sl_node* node, int levels, ukey_t k, uval_t v) {
     node->e.k = k;
     node->e.v = v;
-    node->levels = levels;
     memset(node->next, 0, sizeof(markable_t) * levels);
 
     return node;
 }
 
-static void free_node(struct sl_node* node) {
-    free(node);
+static struct sl_node* alloc_node(struct sl* sl, int levels, ukey_t k, uval_t v, int tid) {
+    return init_node(slab_alloc(sl->slabs[levels - 1], tid), levels, k, v);
+}
+
+static void free_node(struct sl_node* node, int tid) {
+    slab_free(node, tid);
+}
+
+/* ebr frees in its own gc pass, no thread id goes with it */
+static void reclaim_node(struct sl_node* node) {
+    free_node(node, -1);
 }
 
 struct sl* sl_create(int max_levels) {
     assert(max_levels > 0);
     srand(time(0));
 
-    struct sl* sl = (struct sl*) malloc(sizeof(struct sl));
+    struct sl* sl = (struct sl*) aligned_alloc(__alignof__(struct sl), sizeof(struct sl));
     int i;
 
     sl->max_levels = max_levels;
     sl->levels = 1;
+    memset(sl->retries, 0, sizeof(sl->retries));
+
+    sl->slabs = (struct slab**) malloc(max_levels * sizeof(struct slab*));
+    for (i = 0; i < max_levels; i++) {
+        sl->slabs[i] = slab_create(node_size(i + 1));
+    }
 
-    sl->head = alloc_node(max_levels, 0, 0);
-    sl->tail = alloc_node(max_levels, UINT64_MAX, 0);
+    /* head and tail carry full towers, keep them out of the slabs */
+    sl->head = init_node(aligned_alloc(8, node_size(max_levels)), max_levels, 0, 0);
+    sl->tail = init_node(aligned_alloc(8, node_size(max_levels)), max_levels, UINT64_MAX, 0);
 
     for (i = 0; i < max_levels; i++) {
         sl->head->next[i] = (markable_t) sl->tail;
     }
 
-    sl->ebr = ebr_create((free_fun_t) free_node);
+    sl->ebr = ebr_create((free_fun_t) reclaim_node);
 
     return sl;
 }
 
 void sl_destroy(struct sl* sl) {
-    struct sl_node *pred, *curr;
-    
-    pred = sl->head;
-    while(pred) {
-        curr = GET_NODE(pred->next[0]);
-        free_node(pred);
-        pred = curr;
-    }
-    
+    int i;
+
+    /* retired nodes go back to the slabs first */
     ebr_destroy(sl->ebr);
 
+    for (i = 0; i < sl->max_levels; i++) {
+        slab_destroy(sl->slabs[i]);
+    }
+    free(sl->slabs);
+
+    free(sl->head);
+    free(sl->tail);
+
     free(sl);
 }
 
+/* the last predecessor above @level that is still linked at @level */
+static struct sl_node* backtrack(struct sl* sl, struct sl_node** preds, int level) {
+    int i;
+
+    for (i = level + 1; i < sl->max_levels; i++) {
+        if (!IS_MARKED(preds[i], level)) {
+            return preds[i];
+        }
+    }
+
+    return sl->head;
+}
+
 static int find(struct sl* sl, ukey_t k, struct sl_node** preds, struct sl_node** succs, int tid) {
-    struct sl_node *pred, *curr, *succ;
+    struct sl_node *pred, *curr = NULL, *succ;
     int i;
 
-retry:
+    /* max_levels > 0, so the level 0 walk always sets curr */
     pred = sl->head;
-    for (i = sl->max_levels - 1; i >= 0; i--) {
+    i = sl->max_levels - 1;
+    do {
         curr = GET_NODE(pred->next[i]);
         while(1) {
             succ = GET_NODE(curr->next[i]);
             while(IS_MARKED(curr, i)) {
                 if (!cmpxchg2(&pred->next[i], curr, succ)) {
-                    goto retry;
-                }
-                if (i == 0) {
+                    /* resume at this level instead of restarting from the head */
+                    sl->retries[tid].n++;
+                    if (IS_MARKED(pred, i)) {
+                        pred = backtrack(sl, preds, i);
+                    }
+                } else if (i == 0) {
                     ebr_put(sl->ebr, curr, tid);
                 }
 
@@ -87,17 +127,54 @@ retry:
             if (k_cmp(curr->e.k, k) < 0) {
                 pred = curr;
                 curr = succ;
+                prefetch_r(curr);
             } else {
                 break;
             }
         }
         preds[i] = pred;
         succs[i] = curr;
-    }
+        if (i > 0) {
+            prefetch_r(GET_NODE(pred->next[i - 1]));
+        }
+    } while(--i >= 0);
 
     return !k_cmp(curr->e.k, k);
 }
 
+/* read-only version of find, never helps to unlink */
+/* return the first unmarked node >= k, *__pred is the last unmarked node < k */
+static struct sl_node* search(struct sl* sl, ukey_t k, struct sl_node** __pred) {
+    struct sl_node *pred, *curr = NULL, *succ;
+    int i;
+
+    pred = sl->head;
+    i = sl->max_levels - 1;
+    do {
+        curr = GET_NODE(pred->next[i]);
+        while(1) {
+            succ = GET_NODE(curr->next[i]);
+            while(IS_MARKED(curr, i)) {
+                curr = succ;
+                succ = GET_NODE(curr->next[i]);
+            }
+            if (k_cmp(curr->e.k, k) < 0) {
+                pred = curr;
+                curr = succ;
+                prefetch_r(curr);
+            } else {
+                break;
+            }
+        }
+        if (i > 0) {
+            prefetch_r(GET_NODE(pred->next[i - 1]));
+        }
+    } while(--i >= 0);
+
+    *__pred = pred;
+    return curr;
+}
+
 static int get_rand_levels(struct sl* sl) {
     int levels = 1, old;
 
@@ -130,17 +207,24 @@ int sl_insert(struct sl* sl, ukey_t k, uval_t v, int tid) {
 
     node_levels = get_rand_levels(sl);
 
+    node = NULL;
+
 retry:
     if (find(sl, k, preds, succs, tid)) {
+        if (node) {
+            free_node(node, tid);
+        }
         ebr_exit(sl->ebr, tid);
         return -EEXIST;
     } else {
-        node = alloc_node(node_levels, k, v);
+        if (!node) {
+            node = alloc_node(sl, node_levels, k, v, tid);
+        }
         for (i = 0; i < node_levels; i++) {
             node->next[i] = (markable_t) succs[i];
         }
         if (!(cmpxchg2(&preds[0]->next[0], succs[0], node))) {
-            free_node(node);
+            /* not published yet, keep it for the next try */
             goto retry;
         }
         for (i = 1; i < node_levels; i++) {
@@ -159,28 +243,12 @@ retry2:
 }
 
 int sl_lookup(struct sl* sl, ukey_t k, uval_t* v, int tid) {
-    struct sl_node *pred, *curr, *succ;
-    int ret, i;
+    struct sl_node *pred, *curr;
+    int ret;
 
     ebr_enter(sl->ebr, tid);
 
-    pred = sl->head;
-    for (i = sl->max_levels - 1; i >= 0; i--) {
-        curr = GET_NODE(pred->next[i]);
-        while(1) {
-            succ = GET_NODE(curr->next[i]);
-            while(IS_MARKED(curr, i)) {
-                curr = succ;
-                succ = GET_NODE(curr->next[i]);
-            }
-            if (k_cmp(curr->e.k, k) < 0) {
-                pred = curr;
-                curr = succ;
-            } else {
-                break;
-            }
-        }
-    }
+    curr = search(sl, k, &pred);
 
     *v = curr->e.v;
     ret = k_cmp(curr->e.k, k) == 0 ? 0 : -ENOENT; 
@@ -190,52 +258,219 @@ int sl_lookup(struct sl* sl, ukey_t k, uval_t* v, int tid) {
     return ret;
 }
 
-int sl_remove(struct sl* sl, ukey_t k, int tid) {
-   const int max_levels = sl->max_levels;
-    struct sl_node* preds[max_levels];
-    struct sl_node* succs[max_levels];
-    struct sl_node *pred, *succ, *node;
+struct lookup_state {
+    struct sl_node *pred, *curr;
+    int level;
+    unsigned int idx;
+};
+
+/* interleave SL_BATCH_WIDTH searches, a hop of one search hides the cache miss of the others */
+int sl_lookup_batch(struct sl* sl, ukey_t* k_arr, unsigned int len, uval_t* v_arr, int* ret_arr, int tid) {
+    struct lookup_state states[SL_BATCH_WIDTH];
+    struct lookup_state* st;
+    struct sl_node* succ;
+    unsigned int next = 0;
+    int active = 0, found = 0;
     int i;
 
     ebr_enter(sl->ebr, tid);
 
-retry:
-    if (!find(sl, k, preds, succs, tid)) {
-        ebr_exit(sl->ebr, tid);
-        return -ENOENT;
-    } else {
-        node = succs[0];
-        for (i = node->levels - 1; i > 0; i--) {
-            while(!IS_MARKED(node, i)) {
-                succ = GET_NODE(node->next[i]);
-                cmpxchg2(&node->next[i], succ, MARK_NODE2(succ));
+    for (i = 0; i < SL_BATCH_WIDTH && next < len; i++) {
+        st = &states[active++];
+        st->idx = next++;
+        st->level = sl->max_levels - 1;
+        st->pred = sl->head;
+        st->curr = GET_NODE(sl->head->next[st->level]);
+        prefetch_r(st->curr);
+    }
+
+    while(active) {
+        for (i = 0; i < active; i++) {
+            st = &states[i];
+            succ = GET_NODE(st->curr->next[st->level]);
+            if (IS_MARKED(st->curr, st->level)) {
+                st->curr = succ;
+            } else if (k_cmp(st->curr->e.k, k_arr[st->idx]) < 0) {
+                st->pred = st->curr;
+                st->curr = succ;
+            } else if (st->level > 0) {
+                st->level--;
+                st->curr = GET_NODE(st->pred->next[st->level]);
+            } else {
+                /* this search is done, start a new one in its place */
+                if (k_cmp(st->curr->e.k, k_arr[st->idx]) == 0) {
+                    v_arr[st->idx] = st->curr->e.v;
+                    ret_arr[st->idx] = 0;
+                    found++;
+                } else {
+                    v_arr[st->idx] = 0;
+                    ret_arr[st->idx] = -ENOENT;
+                }
+                if (next < len) {
+                    st->idx = next++;
+                    st->level = sl->max_levels - 1;
+                    st->pred = sl->head;
+                    st->curr = GET_NODE(sl->head->next[st->level]);
+                } else {
+                    states[i--] = states[--active];
+                    continue;
+                }
             }
+            prefetch_r(st->curr);
         }
-        while(!IS_MARKED(node, 0)) {
-            succ = GET_NODE(node->next[0]);
-            if (cmpxchg2(&node->next[0], succ, MARK_NODE2(succ))) {
-                /* try to remove physically */
-                find(sl, k, preds, succs, tid);
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return found;
+}
+
+/* mark every level of node, the thread that marks level 0 owns the removal */
+static int claim_node(struct sl* sl, struct sl_node* node, struct sl_node** preds, struct sl_node** succs, int tid) {
+    struct sl_node* succ;
+    int i;
+
+    for (i = get_node_levels(node) - 1; i > 0; i--) {
+        while(!IS_MARKED(node, i)) {
+            succ = GET_NODE(node->next[i]);
+            cmpxchg2(&node->next[i], succ, MARK_NODE2(succ));
+        }
+    }
+    while(!IS_MARKED(node, 0)) {
+        succ = GET_NODE(node->next[0]);
+        if (cmpxchg2(&node->next[0], succ, MARK_NODE2(succ))) {
+            /* try to remove physically */
+            find(sl, node->e.k, preds, succs, tid);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int sl_remove(struct sl* sl, ukey_t k, int tid) {
+    const int max_levels = sl->max_levels;
+    struct sl_node* preds[max_levels];
+    struct sl_node* succs[max_levels];
+    int ret = -ENOENT;
+
+    ebr_enter(sl->ebr, tid);
+
+    if (find(sl, k, preds, succs, tid) && claim_node(sl, succs[0], preds, succs, tid)) {
+        ret = 0;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+/* exact delete-min: claim the first unmarked node on the bottom level */
+int sl_pop_min(struct sl* sl, entry_t* e, int tid) {
+    const int max_levels = sl->max_levels;
+    struct sl_node* preds[max_levels];
+    struct sl_node* succs[max_levels];
+    struct sl_node* node;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = GET_NODE(sl->head->next[0]);
+    while(node != sl->tail) {
+        if (!IS_MARKED(node, 0)) {
+            *e = node->e;
+            if (claim_node(sl, node, preds, succs, tid)) {
                 ebr_exit(sl->ebr, tid);
                 return 0;
             }
         }
-        ebr_exit(sl->ebr, tid);
-        return -ENOENT;
+        node = GET_NODE(node->next[0]);
     }
+
+    ebr_exit(sl->ebr, tid);
+
+    return -ENOENT;
 }
 
-int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid) {
+static __thread unsigned int spray_seed;
+
+/*
+ * SprayList relaxed delete-min: a random walk from height log(p) that
+ * moves up to log^3(p) steps per level lands among the first
+ * O(p log^3(p)) nodes, so concurrent pops rarely fight for one node.
+ * falls back to sl_pop_min() after SL_SPRAY_TRIES failed landings.
+ */
+int sl_spray_pop(struct sl* sl, entry_t* e, int nr_threads, int tid) {
     const int max_levels = sl->max_levels;
     struct sl_node* preds[max_levels];
     struct sl_node* succs[max_levels];
+    struct sl_node *node, *next;
+    int log_p = 0, height, jump, steps;
+    int i, t;
+
+    while((1 << log_p) < nr_threads) {
+        log_p++;
+    }
+    if (log_p == 0) {
+        return sl_pop_min(sl, e, tid);
+    }
+    height = ACCESS_ONCE(sl->levels);
+    if (height > log_p) {
+        height = log_p;
+    }
+    jump = log_p * log_p * log_p;
+
+    if (!spray_seed) {
+        spray_seed = time(0) ^ (tid + 1);
+    }
+
+    ebr_enter(sl->ebr, tid);
+
+    for (t = 0; t < SL_SPRAY_TRIES; t++) {
+        node = sl->head;
+        for (i = height - 1; i >= 0; i--) {
+            steps = rand_r(&spray_seed) % (jump + 1);
+            while(steps) {
+                next = GET_NODE(node->next[i]);
+                if (next == sl->tail) {
+                    break;
+                }
+                node = next;
+                if (!IS_MARKED(node, i)) {
+                    steps--;
+                }
+            }
+        }
+
+        /* take the first live node from the landing spot on */
+        if (node == sl->head) {
+            node = GET_NODE(node->next[0]);
+        }
+        while(node != sl->tail && IS_MARKED(node, 0)) {
+            node = GET_NODE(node->next[0]);
+        }
+        if (node == sl->tail) {
+            break;
+        }
+
+        *e = node->e;
+        if (claim_node(sl, node, preds, succs, tid)) {
+            ebr_exit(sl->ebr, tid);
+            return 0;
+        }
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return sl_pop_min(sl, e, tid);
+}
+
+int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid) {
     struct sl_node *curr, *pred;
     int cnt = 0;
 
     ebr_enter(sl->ebr, tid);
 
-    find(sl, k, preds, succs, tid);
-    pred = succs[0];
+    pred = search(sl, k, &curr);
 
     while(pred != sl->tail) {
         curr = GET_NODE(pred->next[0]);
@@ -250,6 +485,162 @@ int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid)
     return cnt;
 }
 
+int sl_floor(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node *pred, *curr;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    curr = search(sl, k, &pred);
+    if (curr != sl->tail && k_cmp(curr->e.k, k) == 0) {
+        *e = curr->e;
+    } else if (pred != sl->head) {
+        *e = pred->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+int sl_ceiling(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node *pred, *curr;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    curr = search(sl, k, &pred);
+    if (curr != sl->tail) {
+        *e = curr->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+int sl_predecessor(struct sl* sl, ukey_t k, entry_t* e, int tid) {
+    struct sl_node* pred;
+    int ret = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    search(sl, k, &pred);
+    if (pred != sl->head) {
+        *e = pred->e;
+    } else {
+        ret = -ENOENT;
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return ret;
+}
+
+/* collect at most len entries <= k in descending order */
+/* there are no back links, every step is a predecessor search from the top */
+int sl_range_desc(struct sl* sl, ukey_t k, unsigned int len, entry_t* e_arr, int tid) {
+    struct sl_node *pred, *curr;
+    unsigned int cnt = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    curr = search(sl, k, &pred);
+    if (curr != sl->tail && k_cmp(curr->e.k, k) == 0) {
+        e_arr[cnt++] = curr->e;
+    }
+
+    while(cnt < len && pred != sl->head) {
+        e_arr[cnt++] = pred->e;
+        search(sl, pred->e.k, &pred);
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return cnt;
+}
+
+void sl_cursor_open(struct sl* sl, struct sl_cursor* cur, ukey_t k, int tid) {
+    struct sl_node* pred;
+
+    cur->sl = sl;
+    cur->tid = tid;
+
+    ebr_enter(sl->ebr, tid);
+
+    cur->node = search(sl, k, &pred);
+}
+
+/* copy at most len entries under the cursor and move forward, 0 at the end */
+int sl_cursor_next(struct sl_cursor* cur, entry_t* e_arr, unsigned int len) {
+    struct sl_node* node = cur->node;
+    unsigned int cnt = 0;
+
+    while(cnt < len && node != cur->sl->tail) {
+        if (!IS_MARKED(node, 0)) {
+            e_arr[cnt++] = node->e;
+        }
+        node = GET_NODE(node->next[0]);
+    }
+    cur->node = node;
+
+    return cnt;
+}
+
+void sl_cursor_close(struct sl_cursor* cur) {
+    ebr_exit(cur->sl->ebr, cur->tid);
+}
+
+/* call fun on every entry >= k in place until it returns non-zero */
+int sl_scan(struct sl* sl, ukey_t k, scan_fun_t fun, void* arg, int tid) {
+    struct sl_node *pred, *node;
+    int cnt = 0;
+
+    ebr_enter(sl->ebr, tid);
+
+    node = search(sl, k, &pred);
+    while(node != sl->tail) {
+        if (!IS_MARKED(node, 0)) {
+            cnt++;
+            if (fun(node->e.k, node->e.v, arg)) {
+                break;
+            }
+        }
+        node = GET_NODE(node->next[0]);
+    }
+
+    ebr_exit(sl->ebr, tid);
+
+    return cnt;
+}
+
+/* bytes held by the skiplist */
+size_t sl_mem_usage(struct sl* sl) {
+    size_t size = sizeof(struct sl) + 2 * node_size(sl->max_levels);
+    int i;
+
+    for (i = 0; i < sl->max_levels; i++) {
+        size += slab_mem_usage(sl->slabs[i]);
+    }
+
+    return size;
+}
+
+unsigned long sl_retries(struct sl* sl) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < MAX_NUM_THREADS; i++) {
+        sum += ACCESS_ONCE(sl->retries[i].n);
+    }
+
+    return sum;
+}
+
 void sl_print(struct sl* sl) {
     struct sl_node* node;
     int i;
@@ -5,21 +5,43 @@
 #include <stdio.h>
 
 #include "util.h"
+#include "slab.h"
 #include "ebr.h"
 
 typedef size_t markable_t;
 
+/* number of searches sl_lookup_batch keeps in flight */
+#define SL_BATCH_WIDTH  8
+/* landings sl_spray_pop tries before it falls back to sl_pop_min */
+#define SL_SPRAY_TRIES  4
+
+/* the height of a node is not stored, see get_node_levels() */
 struct sl_node {
     entry_t e;
-    int levels;
     markable_t next[0];
 };
 
+/* one per cache line, a thread bumps its own without disturbing others */
+struct sl_counter {
+    unsigned long n;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
 struct sl {
     struct sl_node *head, *tail;
     int max_levels;
     int levels;
     struct ebr* ebr;
+    /* slabs[i] serves nodes of (i + 1) levels */
+    struct slab** slabs;
+    /* per-thread count of traversals that had to be redone */
+    struct sl_counter retries[MAX_NUM_THREADS];
+};
+
+/* a cursor pins the skiplist with an EBR guard until it is closed */
+struct sl_cursor {
+    struct sl* sl;
+    struct sl_node* node;
+    int tid;
 };
 
 #define IS_TAGED(v, t)      ((unsigned long) (v) & t)
@@ -39,8 +61,21 @@ extern struct sl* sl_create(int max_levels);
 extern void sl_destroy(struct sl* sl);
 extern int sl_insert(struct sl* sl, ukey_t k, uval_t v, int tid);
 extern int sl_lookup(struct sl* sl, ukey_t k, uval_t* v, int tid);
+extern int sl_lookup_batch(struct sl* sl, ukey_t* k_arr, unsigned int len, uval_t* v_arr, int* ret_arr, int tid);
 extern int sl_remove(struct sl* sl, ukey_t k, int tid);
+extern int sl_pop_min(struct sl* sl, entry_t* e, int tid);
+extern int sl_spray_pop(struct sl* sl, entry_t* e, int nr_threads, int tid);
 extern int sl_range(struct sl* sl, ukey_t k, unsigned int len, uval_t* v_arr, int tid);
+extern int sl_floor(struct sl* sl, ukey_t k, entry_t* e, int tid);
+extern int sl_ceiling(struct sl* sl, ukey_t k, entry_t* e, int tid);
+extern int sl_predecessor(struct sl* sl, ukey_t k, entry_t* e, int tid);
+extern int sl_range_desc(struct sl* sl, ukey_t k, unsigned int len, entry_t* e_arr, int tid);
+extern void sl_cursor_open(struct sl* sl, struct sl_cursor* cur, ukey_t k, int tid);
+extern int sl_cursor_next(struct sl_cursor* cur, entry_t* e_arr, unsigned int len);
+extern void sl_cursor_close(struct sl_cursor* cur);
+extern int sl_scan(struct sl* sl, ukey_t k, scan_fun_t fun, void* arg, int tid);
+extern size_t sl_mem_usage(struct sl* sl);
+extern unsigned long sl_retries(struct sl* sl);
 extern void ll_print(struct sl* sl);
 
 #ifdef SL_DEBUG
@@ -10,10 +10,15 @@
 #ifdef __APPLE__
 #include "pthread_barrier.h"
 #endif
+#include "atomic.h"
 #include "skiplist.h"
 
 #define N           10000000
 #define NUM_THREAD  8
+#define SCAN_BATCH  64
+#define LOOKUP_BATCH    64
+/* keys every thread tries to remove in the contended phase */
+#define HOT_N       (N / 100)
 
 #define RAND
 // #define DETAIL
@@ -33,6 +38,7 @@
 
 __thread struct timeval t0, t1;
 __thread uval_t v_arr[N];
+__thread entry_t e_arr[N / NUM_THREAD + 1];
 
 pthread_barrier_t barrier;
 pthread_t tids[NUM_THREAD];
@@ -42,6 +48,10 @@ uval_t v[N];
 
 struct sl* sl;
 
+int hot_removed;
+int popped;
+unsigned long retries;
+
 static void gen_data() {
     int i;
 
@@ -114,6 +124,30 @@ static void do_lookup(long id, int expect_ret) {
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
 }
 
+static void do_lookup_batch(long id) {
+    int st, ed, i, j, cnt, ret;
+    double interval;
+    uval_t __v[LOOKUP_BATCH];
+    int __ret[LOOKUP_BATCH];
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i += LOOKUP_BATCH) {
+        cnt = ed - i < LOOKUP_BATCH ? ed - i : LOOKUP_BATCH;
+        ret = sl_lookup_batch(sl, &k[i], cnt, __v, __ret, (int)id);
+        test_assert(ret == cnt);
+        for (j = 0; j < cnt; j++) {
+            test_assert(__ret[j] == 0 && __v[j] == v[i + j]);
+        }
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
 static void do_remove(long id, int expect_ret) {
     int st, ed, i, ret;
     double interval;
@@ -145,6 +179,137 @@ static void do_range(long id) {
     test_print("thread[%ld] end in %.3lf seconds\n", interval);
 }
 
+static void do_neighbour(long id) {
+    int st, ed, i, ret;
+    double interval;
+    entry_t e;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    for (i = st; i < ed; i++) {
+        ret = sl_floor(sl, k[i], &e, (int)id);
+        test_assert(ret == 0 && e.k == k[i]);
+        ret = sl_ceiling(sl, k[i], &e, (int)id);
+        test_assert(ret == 0 && e.k == k[i]);
+        ret = sl_predecessor(sl, k[i], &e, (int)id);
+        test_assert(k[i] == 1 ? ret == -ENOENT : (ret == 0 && e.k == k[i] - 1));
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+static void do_range_desc(long id) {
+    int st, ed, i, ret;
+    double interval;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * N;
+
+    /* keys are 1 ... N, each thread scans its own slice downwards */
+    ret = sl_range_desc(sl, N - st, ed - st, e_arr, (int)id);
+    test_assert(ret == ed - st);
+    for (i = 0; i < ret; i++) {
+        test_assert(e_arr[i].k == N - st - i && e_arr[i].v == e_arr[i].k);
+    }
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+static void do_hot_insert(long id) {
+    int st, ed, i, ret;
+
+    start_measure();
+
+    st = 1.0 * id / NUM_THREAD * HOT_N;
+    ed = 1.0 * (id + 1) / NUM_THREAD * HOT_N;
+
+    for (i = st; i < ed; i++) {
+        ret = sl_insert(sl, k[i], v[i], (int)id);
+        test_assert(ret == 0);
+    }
+}
+
+/* all threads remove the same keys in the same order */
+static void do_contended_remove(long id) {
+    int i, removed = 0;
+    double interval;
+
+    start_measure();
+
+    for (i = 0; i < HOT_N; i++) {
+        if (sl_remove(sl, k[i], (int)id) == 0) {
+            removed++;
+        }
+    }
+    xadd(&hot_removed, removed);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+/* with no concurrent push, exact pops of one thread come out in order */
+static void do_pop(long id, int spray) {
+    entry_t e;
+    ukey_t last = 0;
+    int cnt = 0;
+    double interval;
+
+    start_measure();
+
+    while((spray ? sl_spray_pop(sl, &e, NUM_THREAD, (int)id) : sl_pop_min(sl, &e, (int)id)) == 0) {
+        test_assert(spray || k_cmp(e.k, last) > 0);
+        last = e.k;
+        cnt++;
+    }
+    xadd(&popped, cnt);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+/* stop the visitor halfway */
+static int count_fun(ukey_t k, uval_t v, void* arg) {
+    long* cnt = (long*) arg;
+
+    return ++(*cnt) == N / 2;
+}
+
+static void do_scan(long id) {
+    struct sl_cursor cur;
+    entry_t batch[SCAN_BATCH];
+    ukey_t last = 0;
+    long cnt = 0;
+    int i, ret;
+    double interval;
+
+    start_measure();
+
+    sl_cursor_open(sl, &cur, 0, (int)id);
+    while((ret = sl_cursor_next(&cur, batch, SCAN_BATCH)) > 0) {
+        for (i = 0; i < ret; i++) {
+            test_assert(k_cmp(batch[i].k, last) > 0);
+            last = batch[i].k;
+        }
+        cnt += ret;
+    }
+    sl_cursor_close(&cur);
+    test_assert(cnt == N);
+
+    cnt = 0;
+    ret = sl_scan(sl, 0, count_fun, &cnt, (int)id);
+    test_assert(ret == N / 2 && cnt == N / 2);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
 static void do_barrier(long id, const char* arg) {
     pthread_barrier_wait(&barrier);
     if (id == 0) {
@@ -159,14 +324,34 @@ void* test(void* arg) {
 
     do_barrier(id, "INSERT");
 
+    if (id == 0) {
+        printf("MEMORY %.1lf bytes per key\n", 1.0 * sl_mem_usage(sl) / N);
+    }
+
     do_lookup(id, 0);
 
     do_barrier(id, "LOOKUP");
 
+    do_lookup_batch(id);
+
+    do_barrier(id, "LOOKUP BATCH");
+
     do_range(id);
 
     do_barrier(id, "RANGE");
 
+    do_scan(id);
+
+    do_barrier(id, "SCAN");
+
+    do_neighbour(id);
+
+    do_barrier(id, "FLOOR & CEILING & PREDECESSOR");
+
+    do_range_desc(id);
+
+    do_barrier(id, "RANGE DESC");
+
     do_remove(id, 0);
 
     do_barrier(id, "REMOVE");
@@ -174,6 +359,49 @@ void* test(void* arg) {
     do_lookup(id, -ENOENT);
 
     do_barrier(id, "LOOKUP");
+
+    do_hot_insert(id);
+
+    do_barrier(id, "HOT INSERT");
+
+    if (id == 0) {
+        retries = sl_retries(sl);
+    }
+    pthread_barrier_wait(&barrier);
+
+    do_contended_remove(id);
+
+    do_barrier(id, "CONTENDED REMOVE");
+
+    if (id == 0) {
+        test_assert(hot_removed == HOT_N);
+        printf("CONTENDED REMOVE retried %lu times\n", sl_retries(sl) - retries);
+    }
+
+    do_hot_insert(id);
+
+    do_barrier(id, "HOT INSERT");
+
+    do_pop(id, 0);
+
+    do_barrier(id, "POP MIN");
+
+    if (id == 0) {
+        test_assert(popped == HOT_N);
+        popped = 0;
+    }
+
+    do_hot_insert(id);
+
+    do_barrier(id, "HOT INSERT");
+
+    do_pop(id, 1);
+
+    do_barrier(id, "SPRAY POP");
+
+    if (id == 0) {
+        test_assert(popped == HOT_N);
+    }
 }
 
 int main() {
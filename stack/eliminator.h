@@ -1,7 +1,6 @@
 #ifndef ELIMINATOR_H
 #define ELIMINATOR_H
 
-#include <sys/time.h>
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -25,16 +24,47 @@
 
 #define E_ARR_SIZE  32
 
+/* cycles a thread waits in a slot for a partner, a few microseconds */
+#define E_TIMEOUT_CYCLES    (1UL << 14)
+/* misses (or collisions) in a row before the range shrinks (or grows) */
+#define E_ADAPT_COUNT       8
+
 struct exchanger {
     volatile uint64_t ev;
-};
+} __attribute__((aligned(CACHELINE_SIZE)));
 
 struct elimination {
     struct exchanger e_arr[E_ARR_SIZE];
 };
 
+/*
+ * every thread keeps its own view of the array, as in Hendler, Shavit and
+ * Yerushalmi: waiting alone in a slot means the range is too wide for the
+ * traffic, finding slots taken means it is too narrow.
+ */
+struct el_thread {
+    unsigned int range;
+    unsigned int seed;
+    unsigned int misses;
+    unsigned int collisions;
+};
+
+static __thread struct el_thread el_self;
+
+static inline uint64_t el_rdtsc() {
+    uint32_t lo, hi;
+
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
 static struct elimination* el_create() {
-    struct elimination* el = calloc(1, sizeof(struct elimination));
+    struct elimination* el = aligned_alloc(__alignof__(struct elimination), sizeof(struct elimination));
+    int i;
+
+    for (i = 0; i < E_ARR_SIZE; i++) {
+        el->e_arr[i].ev = EMPTY;
+    }
     return el;
 }
 
@@ -42,77 +72,95 @@ static void el_destroy(struct elimination* el) {
     free(el);
 }
 
-static int exchange(struct exchanger* ex, uint64_t v, unsigned long timeout_usecs, uint64_t* ex_v) {
-    struct timeval t0, t1;
-    unsigned long interval;
+/* one visit to a slot, -EBUSY if it was taken, -ETIMEDOUT if nobody came */
+static int exchange(struct exchanger* ex, uint64_t v, uint64_t* ex_v) {
+    uint64_t t0 = el_rdtsc();
     uint64_t tag;
     uint64_t old_ev, new_ev;
 
     *ex_v = 0;
 
     v &= MASK;
-    gettimeofday(&t0, NULL); 
-    while(1) {
-        gettimeofday(&t1, NULL);
-        interval = (t1.tv_sec - t0.tv_sec) * 1000000UL + t1.tv_usec - t0.tv_usec;
-        if (interval > timeout_usecs) {
-            return -ETIMEDOUT;
+    old_ev = ex->ev;
+    tag = old_ev & (~MASK);
+    switch (tag) {
+    case EMPTY:
+        new_ev = v | WAITING;
+        if (!cmpxchg2(&ex->ev, old_ev, new_ev)) {
+            return -EBUSY;
         }
-        old_ev = ex->ev;
-        tag = old_ev & (~MASK);
-        switch (tag) {
-        case EMPTY:
-            new_ev = v | WAITING;
-            if (cmpxchg2(&ex->ev, old_ev, new_ev)) {
-                while(1) {
-                    gettimeofday(&t1, NULL);
-                    interval = (t1.tv_sec - t0.tv_sec) * 1000000UL + t1.tv_usec - t0.tv_usec;
-                    if (interval > timeout_usecs) {
-                        break;
-                    }
-                    old_ev = ex->ev;
-                    tag = old_ev & (~MASK);
-                    if (tag == BUSY) {
-                        /* another thread exchange it */
-                        ex->ev = EMPTY;
-                        *ex_v = old_ev & MASK;
-                        return 0;
-                    }
-                }
-
-                old_ev = new_ev;
-                if (cmpxchg2(&ex->ev, old_ev, EMPTY)) {
-                    /* too long to wait, let's leave */
-                    return -ETIMEDOUT;
-                } else {
-                    /* thank god, someone exchange it at the last moment */
-                    old_ev = ex->ev;
-                    ex->ev = EMPTY;
-                    *ex_v = old_ev & MASK;
-                    return 0;
-                }
-            }
-            break;
-        case WAITING:
-            /* someone is waiting for us to exchange*/
-            new_ev = v | BUSY;
-            if (cmpxchg2(&ex->ev, old_ev, new_ev)) {
+        while(el_rdtsc() - t0 < E_TIMEOUT_CYCLES) {
+            old_ev = ex->ev;
+            tag = old_ev & (~MASK);
+            if (tag == BUSY) {
+                /* another thread exchange it */
+                ex->ev = EMPTY;
                 *ex_v = old_ev & MASK;
                 return 0;
             }
-            /* better luck next time */
-            break;
-        case BUSY:
-            /* there have been two guys... */
-            break;
+            cpu_relax();
+        }
+
+        old_ev = new_ev;
+        if (cmpxchg2(&ex->ev, old_ev, EMPTY)) {
+            /* too long to wait, let's leave */
+            return -ETIMEDOUT;
+        } else {
+            /* thank god, someone exchange it at the last moment */
+            old_ev = ex->ev;
+            ex->ev = EMPTY;
+            *ex_v = old_ev & MASK;
+            return 0;
         }
-        
+    case WAITING:
+        /* someone is waiting for us to exchange*/
+        new_ev = v | BUSY;
+        if (cmpxchg2(&ex->ev, old_ev, new_ev)) {
+            *ex_v = old_ev & MASK;
+            return 0;
+        }
+        /* better luck next time */
+        return -EBUSY;
+    default:
+        /* there have been two guys... */
+        return -EBUSY;
     }
 }
 
-static int exchang2(struct elimination* el, int fence, uint64_t v, unsigned long timeout_usecs, uint64_t* ex_v) {
-    int idx = rand() % fence;
-    return exchange(&el->e_arr[idx], v, timeout_usecs, ex_v);
+/* try a random slot within this thread's range, then adapt the range */
+static int exchang2(struct elimination* el, uint64_t v, uint64_t* ex_v) {
+    struct el_thread* self = &el_self;
+    int ret;
+
+    if (unlikely(!self->range)) {
+        self->range = E_ARR_SIZE / 2;
+        self->seed = (unsigned int) (unsigned long) self | 1;
+    }
+
+    /* xorshift */
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+
+    ret = exchange(&el->e_arr[self->seed % self->range], v, ex_v);
+    if (!ret) {
+        self->misses = 0;
+        self->collisions = 0;
+    } else if (ret == -ETIMEDOUT) {
+        if (++self->misses == E_ADAPT_COUNT) {
+            if (self->range > 1) {
+                self->range >>= 1;
+            }
+            self->misses = 0;
+        }
+    } else if (++self->collisions == E_ADAPT_COUNT) {
+        if (self->range < E_ARR_SIZE) {
+            self->range <<= 1;
+        }
+        self->collisions = 0;
+    }
+
+    return ret;
 }
 
-#endif
\ No newline at end of file
+#endif
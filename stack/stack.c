@@ -2,35 +2,75 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdint.h>
-#include <unistd.h>
 
 #include "stack.h"
 #include "eliminator.h"
 #include "atomic.h"
+#include "backoff.h"
+#include "flat_combining.h"
+#include "slab.h"
 
 #define STACK_EMPTY ((void*) 0x1234567)
 
-static struct s_node* alloc_node(uval_t v) {
+static struct s_node* alloc_node(struct stack* s, uval_t v, int tid) {
+#ifdef TAGGED_HEAD
+    struct s_node* node = slab_alloc(s->pool, tid);
+#else
     struct s_node* node = malloc(sizeof(struct s_node));
+#endif
     node->next = NULL;
     node->v = v;
 
     return node;
 }
 
-static void free_node(struct s_node* node) {
+/* tid -1 goes through the pool lock, for frees on no thread's behalf */
+static void free_node(struct s_node* node, int tid) {
+#ifdef TAGGED_HEAD
+    slab_free(node, tid);
+#else
     free(node);
+#endif
+}
+
+#ifndef TAGGED_HEAD
+/* the EBR callback */
+static void reclaim_node(struct s_node* node) {
+    free_node(node, -1);
 }
+#endif
+
+#ifdef TAGGED_HEAD
+/* the version makes a stale pop fail, the pool keeps its node readable */
+#define s_enter(s, tid)
+#define s_exit(s, tid)
+#define s_retire(s, node, tid)  slab_free(node, tid)
+#define S_PAIR(node, tag)       (((unsigned __int128) (tag) << 64) | (unsigned long) (node))
+#else
+#define s_enter(s, tid)         ebr_enter((s)->ebr, tid)
+#define s_exit(s, tid)          ebr_exit((s)->ebr, tid)
+#define s_retire(s, node, tid)  ebr_put((s)->ebr, node, tid)
+#endif
 
 extern struct stack* s_create() {
-    struct stack* s = malloc(sizeof(struct stack));
+    struct stack* s = aligned_alloc(__alignof__(struct stack), sizeof(struct stack));
 
     s->head = NULL;
+#ifdef TAGGED_HEAD
+    s->tag = 0;
+    s->pool = slab_create(sizeof(struct s_node));
+#endif
 #ifdef ELIMINATION
     s->el = el_create();
 #endif
+#ifdef FLAT_COMBINING
+    s->fc = aligned_alloc(__alignof__(struct fc), sizeof(struct fc));
+    fc_init(s->fc);
+#endif
 
-    s->ebr = ebr_create((free_fun_t)free_node);
+#ifndef TAGGED_HEAD
+    s->ebr = ebr_create((free_fun_t)reclaim_node);
+#endif
 
     return s;
 }
@@ -42,17 +82,120 @@ extern void s_destroy(struct stack* s) {
     while(curr) {
         pred = curr;
         curr = pred->next;
-        free_node(pred);
+        free_node(pred, -1);
     }
 #ifdef ELIMINATION
     el_destroy(s->el);
 #endif
+#ifdef FLAT_COMBINING
+    free(s->fc);
+#endif
+#ifdef TAGGED_HEAD
+    slab_destroy(s->pool);
+#endif
 
+#ifndef TAGGED_HEAD
     ebr_destroy(s->ebr);
+#endif
 
     free(s);
 }
 
+/* a thread announces itself before its first operation, a no-op without EBR */
+extern void s_thread_register(struct stack* s, int tid) {
+#ifndef TAGGED_HEAD
+    ebr_thread_register(s->ebr, tid);
+#endif
+}
+
+extern void s_thread_unregister(struct stack* s, int tid) {
+#ifndef TAGGED_HEAD
+    ebr_thread_unregister(s->ebr, tid);
+#endif
+}
+
+#ifdef FLAT_COMBINING
+#define S_PUSH  1
+#define S_POP   2
+#define S_TOP   3
+
+/*
+ * head is only touched under the combiner lock, so it is a plain list. a
+ * pop is paired with a push of the same pass first, that push is then
+ * the last one before it and neither goes near the list. nodes are
+ * allocated and freed by their owners, outside the lock.
+ */
+static void s_combine(void* arg, struct fc_record* recs, int nr) {
+    struct stack* s = (struct stack*) arg;
+    struct fc_record* pushes[MAX_NUM_THREADS];
+    struct fc_record* rec;
+    struct s_node* node;
+    int nr_pushes = 0, i;
+
+    for (i = 0; i < nr; i++) {
+        rec = &recs[i];
+        switch (ACCESS_ONCE(rec->op)) {
+        case S_PUSH:
+            pushes[nr_pushes++] = rec;
+            break;
+        case S_POP:
+            if (nr_pushes) {
+                rec->v = pushes[--nr_pushes]->v;
+                fc_done(pushes[nr_pushes], 0);
+                fc_done(rec, 0);
+            } else if (s->head) {
+                node = s->head;
+                s->head = node->next;
+                rec->v = (uval_t) node;
+                fc_done(rec, 0);
+            } else {
+                fc_done(rec, -ENOENT);
+            }
+            break;
+        case S_TOP:
+            node = nr_pushes ? (struct s_node*) pushes[nr_pushes - 1]->v : s->head;
+            if (node) {
+                rec->v = node->v;
+                fc_done(rec, 0);
+            } else {
+                fc_done(rec, -ENOENT);
+            }
+            break;
+        }
+    }
+
+    for (i = 0; i < nr_pushes; i++) {
+        node = (struct s_node*) pushes[i]->v;
+        node->next = s->head;
+        s->head = node;
+        fc_done(pushes[i], 0);
+    }
+}
+
+extern void s_push(struct stack* s, uval_t v, int tid) {
+    uval_t node = (uval_t) alloc_node(s, v, tid);
+
+    fc_request(s->fc, tid, S_PUSH, &node, s_combine, s);
+}
+
+extern int s_pop(struct stack* s, uval_t* v, int tid) {
+    struct s_node* node;
+    uval_t ret_v = 0;
+
+    if (fc_request(s->fc, tid, S_POP, &ret_v, s_combine, s)) {
+        return -ENOENT;
+    }
+    node = (struct s_node*) ret_v;
+    *v = node->v;
+    free_node(node, tid);
+
+    return 0;
+}
+
+extern int s_top(struct stack* s, uval_t* v, int tid) {
+    return fc_request(s->fc, tid, S_TOP, v, s_combine, s);
+}
+#else
 static int try_push(struct stack* s, struct s_node* node) {
     struct s_node* old_top;
 
@@ -61,32 +204,35 @@ static int try_push(struct stack* s, struct s_node* node) {
     return cmpxchg2(&s->head, old_top, node);
 }
 
+#ifdef BACKOFF
 /* backoff can alleviate contention in a high contention situation */
-static inline void backoff() {
-    usleep(BACKOFF_USECS);
-}
+static __thread struct backoff s_backoff;
+#endif
 
 extern void s_push(struct stack* s, uval_t v, int tid) {
-    struct s_node* node = alloc_node(v);
+    struct s_node* node = alloc_node(s, v, tid);
     uint64_t ex_v;
 
-    ebr_enter(s->ebr, tid);
+    s_enter(s, tid);
     
     while(1) {
         if (try_push(s, node)) {
-            ebr_exit(s->ebr, tid);
+#ifdef BACKOFF
+            backoff_done(&s_backoff);
+#endif
+            s_exit(s, tid);
             return;
         } else {
 #ifdef ELIMINATION
-            exchang2(s->el, PREDICT_NUM_THEADS, (uint64_t) node, TIMEOUT_USECS, &ex_v);
-            if (ex_v == 0) {
+            /* a timeout leaves ex_v 0 too, only a pop hands back 0 */
+            if (!exchang2(s->el, (uint64_t) node, &ex_v) && ex_v == 0) {
                 /* the exchanger will free it for us */
-                ebr_exit(s->ebr, tid);
+                s_exit(s, tid);
                 return;
             }
 #else
 #ifdef BACKOFF
-            backoff();
+            backoff_wait(&s_backoff);
 #endif
 #endif
         }
@@ -95,7 +241,21 @@ extern void s_push(struct stack* s, uval_t v, int tid) {
 
 static struct s_node* try_pop(struct stack* s) {
     struct s_node *old_top, *new_top; 
-    
+#ifdef TAGGED_HEAD
+    /* tag first, a pop in between then fails the CAS */
+    unsigned long tag = ACCESS_ONCE(s->tag);
+
+    old_top = ACCESS_ONCE(s->head);
+    if (old_top == NULL) {
+        return STACK_EMPTY;
+    }
+
+    /* may be stale if old_top is gone already, the CAS tells */
+    new_top = old_top->next;
+    if (cmpxchg16(&s->head, S_PAIR(old_top, tag), S_PAIR(new_top, tag + 1))) {
+        return old_top;
+    }
+#else
     old_top = s->head;
     if (old_top == NULL) {
         return STACK_EMPTY;
@@ -105,6 +265,7 @@ static struct s_node* try_pop(struct stack* s) {
     if (cmpxchg2(&s->head, old_top, new_top)) {
         return old_top;
     }
+#endif
 
     return NULL;
 }
@@ -113,48 +274,77 @@ extern int s_pop(struct stack* s, uval_t* v, int tid) {
     struct s_node* top;
     uint64_t ex_v;
 
-    ebr_enter(s->ebr, tid);
+    s_enter(s, tid);
 
     while(1) {
         top = try_pop(s);
         if (top == STACK_EMPTY) {
+#ifdef BACKOFF
+            backoff_done(&s_backoff);
+#endif
+            s_exit(s, tid);
             return -ENOENT;
         } else if (top == NULL) {
 #ifdef ELIMINATION
-            exchang2(s->el, PREDICT_NUM_THEADS, 0UL, TIMEOUT_USECS, &ex_v);
+            exchang2(s->el, 0UL, &ex_v);
             if (ex_v != 0) {
                 /* exchange succeed */
                 *v = ((struct s_node*) ex_v)->v;
-                free_node((struct s_node*) ex_v);
-                ebr_exit(s->ebr, tid);
+                free_node((struct s_node*) ex_v, tid);
+                s_exit(s, tid);
 
                 return 0;
             }
 #else
 #ifdef BACKOFF
-            backoff();
+            backoff_wait(&s_backoff);
 #endif
 #endif
         } else {
+#ifdef BACKOFF
+            backoff_done(&s_backoff);
+#endif
             *v = top->v;
-            ebr_put(s->ebr, top, tid);
-            ebr_exit(s->ebr, tid);
+            s_retire(s, top, tid);
+            s_exit(s, tid);
             return 0;
         }
     }
 }
 
 extern int s_top(struct stack* s, uval_t* v, int tid) {
-    struct s_node* top = s->head;
+    struct s_node* top;
+#ifdef TAGGED_HEAD
+    unsigned long tag;
+    uval_t top_v;
+
+    /* the node may go back to the pool meanwhile, keep v only if no pop came */
+    while(1) {
+        tag = ACCESS_ONCE(s->tag);
+        top = ACCESS_ONCE(s->head);
+        if (!top) {
+            return -ENOENT;
+        }
+        top_v = ACCESS_ONCE(top->v);
+        if (ACCESS_ONCE(s->tag) == tag) {
+            *v = top_v;
+            return 0;
+        }
+    }
+#else
 
     ebr_enter(s->ebr, tid);
 
+    top = s->head;
     if (top) {
         *v = top->v;
+        ebr_exit(s->ebr, tid);
         return 0;
     }
 
     ebr_exit(s->ebr, tid);
 
     return -ENOENT;
+#endif
 }
+#endif
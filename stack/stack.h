@@ -4,12 +4,20 @@
 #include "util.h"
 #include "ebr.h"
 
+/* pause-based, see backoff.h */
 // #define BACKOFF
-#define BACKOFF_USECS   100
 
+/* slot range and timeout adapt, see eliminator.h */
 // #define ELIMINATION
-#define TIMEOUT_USECS   100
-#define PREDICT_NUM_THEADS  8
+
+/* one thread at a time applies everybody's requests, see flat_combining.h */
+// #define FLAT_COMBINING
+
+/*
+ * pop swaps head together with a version by cmpxchg16b (-mcx16), nodes
+ * come from a pool that never gives memory back. no EBR on the way.
+ */
+// #define TAGGED_HEAD
 
 struct s_node {
     uval_t v;
@@ -17,15 +25,27 @@ struct s_node {
 };
 
 struct stack {
+#ifdef TAGGED_HEAD
+    struct s_node* head __attribute__((aligned(16)));
+    /* bumped by every pop */
+    unsigned long tag;
+    struct slab* pool;
+#else
     struct s_node* head;
     struct ebr* ebr;
+#endif
 #ifdef ELIMINATION
     struct elimination* el;
 #endif
+#ifdef FLAT_COMBINING
+    struct fc* fc;
+#endif
 };
 
 extern struct stack* s_create();
 extern void s_destroy(struct stack* s);
+extern void s_thread_register(struct stack* s, int tid);
+extern void s_thread_unregister(struct stack* s, int tid);
 extern void s_push(struct stack* s, uval_t v, int tid);
 extern int s_pop(struct stack* s, uval_t* v, int tid);
 extern int s_top(struct stack* s, uval_t* v, int tid);
@@ -11,6 +11,7 @@
 #include "pthread_barrier.h"
 #endif
 #include "stack.h"
+#include "atomic.h"
 
 #define N           10000000
 /*NUM_THREAD HAS TO BE AN ODD*/
@@ -33,7 +34,6 @@
 #endif
 
 __thread struct timeval t0, t1;
-__thread uval_t v_arr[N];
 
 pthread_barrier_t barrier;
 pthread_t tids[NUM_THREAD];
@@ -43,6 +43,13 @@ uval_t v[N];
 
 struct stack* s;
 
+uval_t pushed, popped;
+
+/* thread counts of the sweep, from no contention up to MAX_NUM_THREADS */
+int sweep_threads;
+char sweep_name[32];
+uval_t swept, total;
+
 static void gen_data() {
     int i;
 
@@ -114,8 +121,11 @@ static void do_pop(long id, int expect_ret) {
     ed = 1.0 * (id + 1) / NUM_THREAD * N;
 
     for (i = st; i < ed; i++) {
-        s_pop(s, &v, (int)id);
+        ret = s_pop(s, &v, (int)id);
         test_assert(expect_ret == -1 || ret == expect_ret);
+        if (!ret) {
+            xadd(&popped, v);
+        }
     }
 
     interval = end_measure();
@@ -138,8 +148,65 @@ void* pop_fun(void* arg) {
     do_barrier(id, "PUSH & POP");
 }
 
+/* every thread pushes before it pops, so no pop finds the stack empty */
+static void do_push_pop(long id, int nr_threads) {
+    int st, ed, i, ret;
+    double interval;
+    uval_t v0, sum = 0;
+
+    start_measure();
+
+    st = 1.0 * id / nr_threads * N;
+    ed = 1.0 * (id + 1) / nr_threads * N;
+
+    for (i = st; i < ed; i++) {
+        s_push(s, v[i], (int)id);
+        ret = s_pop(s, &v0, (int)id);
+        test_assert(ret == 0);
+        sum += v0;
+    }
+    xadd(&swept, sum);
+
+    interval = end_measure();
+    test_print("thread[%ld] end in %.3lf seconds\n", interval);
+}
+
+void* sweep_fun(void* arg) {
+    long id = (long) arg;
+
+    do_push_pop(id, sweep_threads);
+
+    do_barrier(id, sweep_name);
+
+    return NULL;
+}
+
+static void do_sweep() {
+    pthread_t sweep_tids[MAX_NUM_THREADS];
+    long i;
+
+    for (sweep_threads = 1; sweep_threads <= MAX_NUM_THREADS; sweep_threads *= 2) {
+        sprintf(sweep_name, "SWEEP %d THREADS", sweep_threads);
+        swept = 0;
+
+        pthread_barrier_init(&barrier, NULL, sweep_threads);
+        for (i = 0; i < sweep_threads; i++) {
+            s_thread_register(s, i);
+            pthread_create(&sweep_tids[i], NULL, sweep_fun, (void*) i);
+        }
+        for (i = 0; i < sweep_threads; i++) {
+            pthread_join(sweep_tids[i], NULL);
+            s_thread_unregister(s, i);
+        }
+        pthread_barrier_destroy(&barrier);
+
+        test_assert(swept == total);
+    }
+}
+
 int main() {
     long i;
+    uval_t v0;
 
     gen_data();
 
@@ -148,17 +215,35 @@ int main() {
     pthread_barrier_init(&barrier, NULL, NUM_THREAD);
 
     for (i = 0; i < NUM_THREAD / 2; i++) {
-        ebr_thread_register(s->ebr, i);
-        ebr_thread_register(s->ebr, NUM_THREAD / 2 + i);
+        s_thread_register(s, i);
+        s_thread_register(s, NUM_THREAD / 2 + i);
         pthread_create(&tids[i], NULL, push_fun, (void*) i);
         pthread_create(&tids[NUM_THREAD / 2 + i], NULL, pop_fun, (void*) (NUM_THREAD / 2 + i));
     }
 
     for (i = 0; i < NUM_THREAD; i++) {
         pthread_join(tids[i], NULL);
-        ebr_thread_unregister(s->ebr, i);
     }
 
+    /* whatever was not popped is still on the stack, eliminated pairs included */
+    for (i = 0; i < N / 2; i++) {
+        pushed += v[i];
+    }
+    while(!s_pop(s, &v0, 0)) {
+        popped += v0;
+    }
+    test_assert(pushed == popped);
+
+    for (i = 0; i < NUM_THREAD; i++) {
+        s_thread_unregister(s, i);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    for (i = 0; i < N; i++) {
+        total += v[i];
+    }
+    do_sweep();
+
     s_destroy(s);
 
     return 0;